@@ -28,9 +28,11 @@
 #include <QLabel>
 #include <QCheckBox>
 #include <QDoubleSpinBox>
+#include <QTimer>
 
 #include "fwe_main.h"
 #include "fwe_dialog_preferences.h"
+#include "fwe_evds_residency.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -145,6 +147,56 @@ void PreferencesDialog::createPerfomance() {
 	connect(checkBox, SIGNAL(stateChanged(int)), this, SLOT(setBoolWarn(int)));
 	layout->addRow("Use FXAA (antialiasing):<br>(default: <i>true</i>)", checkBox);
 
+	checkBox = new QCheckBox();
+	checkBox->setObjectName("rendering.interactive_quality");
+	checkBox->setChecked(fw_editor_settings->value("rendering.interactive_quality").toBool());
+	connect(checkBox, SIGNAL(stateChanged(int)), this, SLOT(setBool(int)));
+	layout->addRow("Reduce quality while moving camera:<br>(default: <i>true</i>)", checkBox);
+
+	spinBox = new QSpinBox();
+	spinBox->setObjectName("rendering.interactive_frame_time");
+	spinBox->setRange(5,1000);
+	spinBox->setSuffix(" ms");
+	spinBox->setValue(fw_editor_settings->value("rendering.interactive_frame_time").toInt());
+	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setInteger(int)));
+	layout->addRow("Target frame time while moving camera:<br>(default: <i>33</i> ms)", spinBox);
+
+	spinBox = new QSpinBox();
+	spinBox->setObjectName("rendering.interactive_fps");
+	spinBox->setRange(0,240);
+	spinBox->setSuffix(" FPS");
+	spinBox->setSpecialValueText("Unlimited");
+	spinBox->setValue(fw_editor_settings->value("rendering.interactive_fps").toInt());
+	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setInteger(int)));
+	layout->addRow("Frame rate limit while moving camera:<br>(default: <i>30</i> FPS)", spinBox);
+
+	spinBox = new QSpinBox();
+	spinBox->setObjectName("rendering.mesh_budget");
+	spinBox->setRange(0,65536);
+	spinBox->setSuffix(" MB");
+	spinBox->setSpecialValueText("Unlimited");
+	spinBox->setValue(fw_editor_settings->value("rendering.mesh_budget").toInt());
+	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setInteger(int)));
+	layout->addRow("Memory budget for meshes:<br>(default: <i>512</i> MB)", spinBox);
+
+	spinBox = new QSpinBox();
+	spinBox->setObjectName("rendering.mesh_cache_budget");
+	spinBox->setRange(0,65536);
+	spinBox->setSuffix(" MB");
+	spinBox->setSpecialValueText("Unlimited");
+	spinBox->setValue(fw_editor_settings->value("rendering.mesh_cache_budget").toInt());
+	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setInteger(int)));
+	layout->addRow("Memory budget for cached meshes:<br>(default: <i>256</i> MB)", spinBox);
+
+	meshStatistics = new QLabel();
+	meshStatistics->setTextFormat(Qt::RichText);
+	layout->addRow("Mesh memory usage:", meshStatistics);
+	updateStatistics();
+
+	QTimer* timer = new QTimer(this);
+	connect(timer, SIGNAL(timeout()), this, SLOT(updateStatistics()));
+	timer->start(1000);
+
 	spinBox = new QSpinBox();
 	spinBox->setObjectName("ui.autosave");
 	spinBox->setRange(5,60*60*12);
@@ -152,6 +204,21 @@ void PreferencesDialog::createPerfomance() {
 	spinBox->setValue(fw_editor_settings->value("ui.autosave").toInt()/1000);
 	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setIntegerx1000(int)));
 	layout->addRow("Interval between autosaves:<br>(default: <i>30</i> seconds)", spinBox);
+
+	checkBox = new QCheckBox();
+	checkBox->setObjectName("ui.journal_saves");
+	checkBox->setChecked(fw_editor_settings->value("ui.journal_saves").toBool());
+	connect(checkBox, SIGNAL(stateChanged(int)), this, SLOT(setBool(int)));
+	layout->addRow("Only save changes into journal:<br>(default: <i>false</i>)", checkBox);
+
+	spinBox = new QSpinBox();
+	spinBox->setObjectName("ui.lazy_loading_objects");
+	spinBox->setRange(0,10000000);
+	spinBox->setSuffix(" objects");
+	spinBox->setSpecialValueText("Never");
+	spinBox->setValue(fw_editor_settings->value("ui.lazy_loading_objects").toInt());
+	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setInteger(int)));
+	layout->addRow("Create deep parts on demand in files larger than:<br>(default: <i>5000</i> objects)", spinBox);
 }
 
 
@@ -264,4 +331,20 @@ void PreferencesDialog::setDouble(double value) {
 void PreferencesDialog::setDoubleWarn(double value) {
 	needReload->show();
 	fw_editor_settings->setValue(sender()->objectName(),value);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Show memory used by meshes in all open editors
+////////////////////////////////////////////////////////////////////////////////
+void PreferencesDialog::updateStatistics() {
+	EVDS::MeshResidencyStatistics stats = EVDS::MeshResidencyManager::getTotalStatistics();
+	meshStatistics->setText(tr("%1 MB in %2 meshes (%3 LODs evicted)<br>"
+							   "%4 MB cached, %5 reloads from cache, %6 regenerated")
+		.arg(stats.residentBytes/(1024.0*1024.0),0,'f',1)
+		.arg(stats.meshes)
+		.arg(stats.evictedLODs)
+		.arg(stats.cachedBytes/(1024.0*1024.0),0,'f',1)
+		.arg(stats.cacheHits)
+		.arg(stats.cacheMisses));
 }
\ No newline at end of file
@@ -46,6 +46,7 @@ private slots:
 	void setBoolWarn(int value);
 	void setDouble(double value);
 	void setDoubleWarn(double value);
+	void updateStatistics();
 
 private:
 	void createPerfomance();
@@ -53,6 +54,7 @@ private:
 	void createOther();
 
 	QLabel* needReload;
+	QLabel* meshStatistics;
 	QListWidget* pages;
 	QStackedWidget* contents;
 };
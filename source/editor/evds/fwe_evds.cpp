@@ -31,6 +31,7 @@
 #include <QSettings>
 #include <QMessageBox>
 #include <QApplication>
+#include <QClipboard>
 #include <QAction>
 #include <QMenu>
 #include <QSlider>
@@ -54,11 +55,13 @@
 #include "fwe_evds_object_model.h"
 #include "fwe_evds_object_renderer.h"
 #include "fwe_evds_modifiers.h"
+#include "fwe_evds_residency.h"
 #include "fwe_glscene.h"
 #include "fwe_prop_sheet.h"
 
 #include "fwe_dock_objectlist.h"
 #include "fwe_dock_properties.h"
+#include "fwe_dock_performance.h"
 
 using namespace EVDS;
 
@@ -70,11 +73,15 @@ Editor::Editor(FWE::EditorWindow* in_window) : FWE::Editor(in_window) {
 	selected = NULL;
 	setAcceptDrops(true);
 
+	//Create worker threads for LOD meshes of all objects
+	lod_scheduler = new ObjectLODScheduler(this);
+
 	//Create initializer thread
 	initializer = new ObjectInitializer(getEditorWindow()->getEditRoot());
 	connect(initializer, SIGNAL(signalObjectReady()), this, SLOT(rootInitialized()), Qt::QueuedConnection);
 	initializer->start();
 	initializer->updateObject(); //Must be called before first call to getObject
+	connect(getEditorWindow(), SIGNAL(childrenCreated(EVDS::Object*)), this, SLOT(childrenCreated(EVDS::Object*)));
    
 	//Create parts of main UI
 	createMenuToolbar();
@@ -95,8 +102,13 @@ Editor::Editor(FWE::EditorWindow* in_window) : FWE::Editor(in_window) {
 	csection_properties->setWindowTitle("Cross-section Properties");
 	addDockWidget(Qt::RightDockWidgetArea, csection_properties);
 
+	//Create performance counters next to object properties
+	performance = new Dock::Performance(this,this);
+	tabifyDockWidget(object_properties,performance);
+
 	//Setup initial layout
 	object_list->raise();
+	object_properties->raise();
 
 	//Create informational docks
 	//createInformationDock();
@@ -112,6 +124,9 @@ Editor::Editor(FWE::EditorWindow* in_window) : FWE::Editor(in_window) {
 	//Create modifiers manager
 	modifiers_manager = new ObjectModifiersManager(this);
 	modifiers_manager->setInitializing(true);
+
+	//Create mesh residency manager
+	residency_manager = new MeshResidencyManager(this);
 }
 
 
@@ -119,10 +134,18 @@ Editor::Editor(FWE::EditorWindow* in_window) : FWE::Editor(in_window) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 Editor::~Editor() {
+	qDebug("Editor::~Editor: stop LOD workers");
+	delete lod_scheduler;
+	lod_scheduler = 0;
+
 	qDebug("Editor::~Editor: destroy modifiers manager");
 	delete modifiers_manager;
 	modifiers_manager = 0;
 
+	qDebug("Editor::~Editor: destroy residency manager");
+	delete residency_manager;
+	residency_manager = 0;
+
 	qDebug("Editor::~Editor: stop initializer");
 	initializer->stopWork();
 	initializer->deleteLater();
@@ -219,9 +242,9 @@ void Editor::createMenuToolbar() {
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Callback from when object was modified
 ////////////////////////////////////////////////////////////////////////////////
-void Editor::setModified(bool informationUpdate) {
+void Editor::setModified(Object* object, bool informationUpdate) {
 	if (informationUpdate) updateInformation(false);
-	getEditorWindow()->setModified();
+	getEditorWindow()->setModified(object);
 	initializer->updateObject();
 }
 
@@ -230,9 +253,16 @@ void Editor::setModified(bool informationUpdate) {
 /// @brief Callback when root object was initialized
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::rootInitialized() {
-	getEditorWindow()->getEditRoot()->recursiveUpdateInformation(initializer);
 	updateInformation(true);
-	update();
+	glscene->invalidate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief New objects must be assigned to their initialized copies
+////////////////////////////////////////////////////////////////////////////////
+void Editor::childrenCreated(EVDS::Object* object) {
+	initializer->structureChanged();
 }
 
 
@@ -255,7 +285,7 @@ void Editor::updateObject(Object* object) {
 	if (object) {
 		object_list->getModel()->updateObject(object);
 	}
-	glscene->update();
+	glscene->invalidate();
 }
 
 
@@ -274,8 +304,44 @@ void Editor::addObject() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::removeObject() {
+	object_list->getModel()->removeObjects(object_list->selectedIndexes());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Put selected objects into clipboard. Unlike dragged objects they are
+///  encoded right away, so they can be pasted after the document is closed.
+////////////////////////////////////////////////////////////////////////////////
+void Editor::copy() {
+	QModelIndexList indexes = object_list->selectedIndexes();
+	if (indexes.isEmpty()) return;
+
+	QMimeData* data = object_list->getModel()->mimeData(indexes);
+	ObjectMimeData* objectData = qobject_cast<ObjectMimeData*>(data);
+	if (objectData) objectData->encode();
+	QApplication::clipboard()->setMimeData(data);
+}
+
+void Editor::cut() {
+	if (object_list->selectedIndexes().isEmpty()) return;
+	copy();
+	removeObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Insert objects from clipboard after the selected one
+////////////////////////////////////////////////////////////////////////////////
+void Editor::paste() {
+	const QMimeData* data = QApplication::clipboard()->mimeData();
+	if (!data || !data->hasFormat("application/vnd.evds+xml")) return;
+
 	QModelIndex index = object_list->currentIndex();
-	object_list->getModel()->removeRow(index.row(),index.parent());
+	if (index.isValid()) {
+		object_list->getModel()->dropMimeData(data,Qt::CopyAction,index.row()+1,0,index.parent());
+	} else {
+		object_list->getModel()->dropMimeData(data,Qt::CopyAction,-1,0,QModelIndex());
+	}
 }
 
 
@@ -291,7 +357,7 @@ void Editor::selectObject(const QModelIndex& index) {
 
 		//Update information
 		updateInformation(true);
-		getEditorWindow()->updateObject(NULL);
+		glscene->requestRender();
 
 		//Update comments
 		//disconnect(comments, SIGNAL(textChanged()), this, SLOT(commentChanged()));
@@ -323,8 +389,8 @@ void Editor::selectObject(const QModelIndex& index) {
 	//Update information
 	updateInformation(true);
 
-	//Redraw
-	getEditorWindow()->updateObject(NULL);
+	//Redraw (only selection has changed)
+	glscene->requestRender();
 }
 
 
@@ -346,7 +412,8 @@ void Editor::csectionPropertySheetUpdated(QWidget* old_sheet, QWidget* new_sheet
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::finishInitializing() {
-	initializer->updateObject();
+	object_list->reloadObjects();
+	initializer->structureChanged();
 	updateInformation(false);
 
 	//Finish initialization
@@ -430,13 +497,13 @@ void Editor::updateInformation(bool ready) {
 				.arg(glscene->getCollection()->boundingBox().zLength(),0,'G',3);
 		}
 
-		if (object->getType() == "fuel_tank") {
+		if (object->getTypeId() == Object::TYPE_FUEL_TANK) {
 			information = information + tr("\nFuel mass: %1 kg\n")
 			.arg(object->getInformationVariable("fuel_mass"));
 			information = information + tr("Fuel volume: %1 m\xB3\n")
 			.arg(object->getInformationVariable("fuel_volume"));
 		}
-		if (object->getType() == "rocket_engine") {
+		if (object->getTypeId() == Object::TYPE_ROCKET_ENGINE) {
 			information = information + tr("\nVacuum parameters:\n");
 			information = information + tr(
 				"Isp: %1 sec\n"
@@ -552,5 +619,4 @@ void Editor::showComments() {
 void Editor::showCutsection() {
 	QAction* action = dynamic_cast<QAction*>(sender());
 	glscene->setCutsectionPlane(action->property("index").toInt(),action->isChecked());
-	glscene->update();
 }
\ No newline at end of file
@@ -52,6 +52,7 @@ namespace FWE {
 namespace Dock {
 	class ObjectList;
 	class Properties;
+	class Performance;
 }
 namespace EVDS {
 	class GLScene;
@@ -60,6 +61,8 @@ namespace EVDS {
 	class ObjectInitializer;
 	class ObjectTreeModel;
 	class ObjectModifiersManager;
+	class MeshResidencyManager;
+	class ObjectLODScheduler;
 	class Editor : public FWE::Editor {
 		Q_OBJECT
 
@@ -68,7 +71,7 @@ namespace EVDS {
 		~Editor();
 
 		//EVDS-editor specific
-		void setModified(bool informationUpdate = true);
+		void setModified(Object* object, bool informationUpdate = true);
 		void objectPropertySheetUpdated(QWidget* old_sheet, QWidget* new_sheet);
 		void csectionPropertySheetUpdated(QWidget* old_sheet, QWidget* new_sheet);
 		void finishInitializing();
@@ -79,9 +82,17 @@ namespace EVDS {
 		Object* getSelected() { return selected; }
 		void clearSelection() { selected = NULL; }
 
+		//Clipboard operations on the selected objects
+		void cut();
+		void copy();
+		void paste();
+
 		//Various references to other objects
 		GLScene* getGLScene() { return glscene; }
 		ObjectModifiersManager* getModifiersManager() { return modifiers_manager; }
+		MeshResidencyManager* getResidencyManager() { return residency_manager; }
+		ObjectLODScheduler* getLODScheduler() { return lod_scheduler; }
+		ObjectInitializer* getInitializer() { return initializer; }
 
 	protected:
 		void dropEvent(QDropEvent *event);
@@ -90,6 +101,7 @@ namespace EVDS {
 
 	private slots:
 		void rootInitialized(); //Information about initialized object is available
+		void childrenCreated(EVDS::Object* object); //Children of a collapsed object were created
 		void commentChanged();
 
 		void addObject();
@@ -112,6 +124,7 @@ namespace EVDS {
 		Dock::ObjectList*	object_list;			//List of objects
 		Dock::Properties*	object_properties;		//Property sheets for objects
 		Dock::Properties*	csection_properties;	//Property sheets for cross-sections
+		Dock::Performance*	performance;			//Live performance counters
 
 		//Selected object
 		EVDS::Object* selected;
@@ -133,10 +146,12 @@ namespace EVDS {
 		QAction*			cutsection_y;
 		QAction*			cutsection_z;*/
 
-		//Rendering-related (OpenGL scene and modifiers manager)
+		//Rendering-related (OpenGL scene, modifiers and mesh residency managers)
 		GLScene*			glscene;
 		GLView*				glview;
 		ObjectModifiersManager* modifiers_manager;
+		MeshResidencyManager* residency_manager;
+		ObjectLODScheduler* lod_scheduler;
 
 		//EVDS objects (initialized/simulation area)
 		ObjectInitializer* initializer;
@@ -0,0 +1,417 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QtEndian>
+#include "fwe_evds_binary.h"
+
+using namespace EVDS;
+
+//File signature and version
+#define FWE_BINARY_MAGIC			"EVDB"
+#define FWE_BINARY_VERSION			1
+//Size of the file header
+#define FWE_BINARY_HEADER_SIZE		32
+//Size of a single entry in the sections index
+#define FWE_BINARY_SECTION_SIZE		24
+//Types of nodes
+#define FWE_BINARY_NODE_ELEMENT		1
+#define FWE_BINARY_NODE_TEXT		2
+//Index of a missing string
+#define FWE_BINARY_NO_STRING		0xFFFFFFFF
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Binary EVDS document.
+///
+/// File layout (all numbers are little-endian):
+///  - Header: signature, version, offset of string table, offset of sections index
+///  - Root element: name and attributes
+///  - Sections: one element tree for every top-level object
+///  - String table: element names, attribute names and attribute values
+///  - Sections index: offset, length, name and type of every top-level object
+///
+/// Elements are stored as name, attributes and length-prefixed contents, so any
+/// element can be skipped without decoding it. Whitespace between elements and
+/// comments are not stored. Whitespace-only values of elements are kept.
+////////////////////////////////////////////////////////////////////////////////
+BinaryDocument::BinaryDocument() {
+	clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+BinaryDocument::~BinaryDocument() {
+	clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void BinaryDocument::clear() {
+	if (file.isOpen()) file.close(); //Also unmaps the file
+	buffer.clear();
+	data = 0;
+	size = 0;
+
+	strings.clear();
+	stringIndices.clear();
+	sections.clear();
+	rootName = FWE_BINARY_NO_STRING;
+	rootAttributes.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+quint32 BinaryDocument::addString(const QString& str) {
+	QHash<QString,quint32>::const_iterator i = stringIndices.constFind(str);
+	if (i != stringIndices.constEnd()) return i.value();
+
+	quint32 index = strings.count();
+	strings.append(str);
+	stringIndices[str] = index;
+	return index;
+}
+
+void BinaryDocument::writeVarint(quint64 value) {
+	do {
+		uchar byte = value & 0x7F;
+		value >>= 7;
+		if (value) byte |= 0x80;
+		buffer.append((char)byte);
+	} while (value);
+}
+
+void BinaryDocument::writeText(const QString& str) {
+	QByteArray text = str.toUtf8();
+	buffer.append((char)FWE_BINARY_NODE_TEXT);
+	writeVarint(text.size());
+	buffer.append(text);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Encode XML description. Only the first root element is encoded
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::fromXML(const QByteArray& description) {
+	clear();
+	QXmlStreamReader xml(description);
+
+	//Find root element
+	while ((!xml.atEnd()) && (!xml.isStartElement())) xml.readNext();
+	if (!xml.isStartElement()) return false;
+
+	//Write header (offsets are filled in later) and root element
+	buffer.fill(0,FWE_BINARY_HEADER_SIZE);
+	memcpy(buffer.data(),FWE_BINARY_MAGIC,4);
+	qToLittleEndian<quint32>(FWE_BINARY_VERSION,(uchar*)buffer.data()+4);
+
+	rootName = addString(xml.name().toString());
+	QXmlStreamAttributes attributes = xml.attributes();
+	writeVarint(rootName);
+	writeVarint(attributes.count());
+	for (int i = 0; i < attributes.count(); i++) {
+		writeVarint(addString(attributes[i].name().toString()));
+		writeVarint(addString(attributes[i].value().toString()));
+	}
+
+	//Every element inside of the root is a separate section
+	while (!xml.atEnd()) {
+		xml.readNext();
+		if (xml.isStartElement()) {
+			Section section;
+			section.offset = buffer.size();
+			section.name = xml.attributes().hasAttribute("name") ?
+				addString(xml.attributes().value("name").toString()) : FWE_BINARY_NO_STRING;
+			section.type = xml.attributes().hasAttribute("type") ?
+				addString(xml.attributes().value("type").toString()) : FWE_BINARY_NO_STRING;
+			if (!encodeElement(&xml)) return false;
+			section.length = buffer.size() - section.offset;
+			sections.append(section);
+		} else if (xml.isEndElement()) {
+			break;
+		}
+	}
+	if (xml.hasError()) return false;
+
+	//Write string table
+	quint64 stringTableOffset = buffer.size();
+	writeVarint(strings.count());
+	for (int i = 0; i < strings.count(); i++) {
+		QByteArray str = strings[i].toUtf8();
+		writeVarint(str.size());
+		buffer.append(str);
+	}
+
+	//Write sections index
+	quint64 indexOffset = buffer.size();
+	writeVarint(sections.count());
+	for (int i = 0; i < sections.count(); i++) {
+		uchar entry[FWE_BINARY_SECTION_SIZE];
+		qToLittleEndian<quint64>(sections[i].offset,entry+0);
+		qToLittleEndian<quint64>(sections[i].length,entry+8);
+		qToLittleEndian<quint32>(sections[i].name,entry+16);
+		qToLittleEndian<quint32>(sections[i].type,entry+20);
+		buffer.append((const char*)entry,FWE_BINARY_SECTION_SIZE);
+	}
+
+	//Finish header
+	qToLittleEndian<quint64>(stringTableOffset,(uchar*)buffer.data()+8);
+	qToLittleEndian<quint64>(indexOffset,(uchar*)buffer.data()+16);
+	data = (const uchar*)buffer.constData();
+	size = buffer.size();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Encode element and everything inside of it (reader is at its start)
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::encodeElement(QXmlStreamReader* xml) {
+	buffer.append((char)FWE_BINARY_NODE_ELEMENT);
+	writeVarint(addString(xml->name().toString()));
+
+	QXmlStreamAttributes attributes = xml->attributes();
+	writeVarint(attributes.count());
+	for (int i = 0; i < attributes.count(); i++) {
+		writeVarint(addString(attributes[i].name().toString()));
+		writeVarint(addString(attributes[i].value().toString()));
+	}
+
+	//Length of contents is written once they are encoded
+	int lengthOffset = buffer.size();
+	buffer.append(QByteArray(4,0));
+
+	//Whitespace is only formatting if element has other elements inside, otherwise
+	// it's the value of the element
+	bool hasElements = false;
+	QString whitespace;
+	while (!xml->atEnd()) {
+		xml->readNext();
+		if (xml->isStartElement()) {
+			hasElements = true;
+			if (!encodeElement(xml)) return false;
+		} else if (xml->isCharacters() && xml->isWhitespace()) {
+			whitespace += xml->text().toString();
+		} else if (xml->isCharacters()) {
+			writeText(xml->text().toString());
+		} else if (xml->isEndElement()) {
+			if ((!hasElements) && (!whitespace.isEmpty())) writeText(whitespace);
+			qToLittleEndian<quint32>(buffer.size()-lengthOffset-4,(uchar*)buffer.data()+lengthOffset);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode a single section. It's placed inside of the root element
+////////////////////////////////////////////////////////////////////////////////
+QByteArray BinaryDocument::toXML(int section) {
+	QByteArray description;
+	if ((!data) || (section < 0) || (section >= sections.count())) return description;
+
+	QXmlStreamWriter xml(&description);
+	xml.setAutoFormatting(true);
+	xml.setAutoFormattingIndent(-1);
+	xml.writeStartDocument();
+	writeRootStart(&xml);
+		const uchar* ptr = data + sections[section].offset;
+		if (!decodeNodes(&xml,ptr,ptr+sections[section].length)) return QByteArray();
+	xml.writeEndElement();
+	xml.writeEndDocument();
+	return description;
+}
+
+void BinaryDocument::writeRootStart(QXmlStreamWriter* xml) {
+	xml->writeStartElement(getString(rootName));
+	for (int i = 0; i < rootAttributes.count(); i++) {
+		xml->writeAttribute(getString(rootAttributes[i].first),getString(rootAttributes[i].second));
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::readVarint(const uchar** ptr, const uchar* end, quint64* value) {
+	*value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (*ptr >= end) return false;
+		uchar byte = *((*ptr)++);
+		*value |= ((quint64)(byte & 0x7F)) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+bool BinaryDocument::readAttributes(const uchar** ptr, const uchar* end, QList<QPair<quint32,quint32> >* attributes) {
+	quint64 count,name,value;
+	if (!readVarint(ptr,end,&count)) return false;
+	for (quint64 i = 0; i < count; i++) {
+		if (!readVarint(ptr,end,&name)) return false;
+		if (!readVarint(ptr,end,&value)) return false;
+		if ((name >= (quint64)strings.count()) || (value >= (quint64)strings.count())) return false;
+		attributes->append(qMakePair((quint32)name,(quint32)value));
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode elements and text between the given pointers
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::decodeNodes(QXmlStreamWriter* xml, const uchar* ptr, const uchar* end) {
+	while (ptr < end) {
+		uchar type = *(ptr++);
+		if (type == FWE_BINARY_NODE_ELEMENT) {
+			quint64 name;
+			QList<QPair<quint32,quint32> > attributes;
+			if (!readVarint(&ptr,end,&name)) return false;
+			if (name >= (quint64)strings.count()) return false;
+			if (!readAttributes(&ptr,end,&attributes)) return false;
+			if (end - ptr < 4) return false;
+			quint32 length = qFromLittleEndian<quint32>(ptr);
+			ptr += 4;
+			if ((quint64)(end - ptr) < length) return false;
+
+			xml->writeStartElement(strings[name]);
+			for (int i = 0; i < attributes.count(); i++) {
+				xml->writeAttribute(strings[attributes[i].first],strings[attributes[i].second]);
+			}
+			if (!decodeNodes(xml,ptr,ptr+length)) return false;
+			xml->writeEndElement();
+			ptr += length;
+		} else if (type == FWE_BINARY_NODE_TEXT) {
+			quint64 length;
+			if (!readVarint(&ptr,end,&length)) return false;
+			if ((quint64)(end - ptr) < length) return false;
+			xml->writeCharacters(QString::fromUtf8((const char*)ptr,length));
+			ptr += length;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read string table, sections index and root element
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::parse() {
+	if (size < FWE_BINARY_HEADER_SIZE) return false;
+	if (memcmp(data,FWE_BINARY_MAGIC,4) != 0) return false;
+	if (qFromLittleEndian<quint32>(data+4) != FWE_BINARY_VERSION) return false;
+	quint64 stringTableOffset = qFromLittleEndian<quint64>(data+8);
+	quint64 indexOffset = qFromLittleEndian<quint64>(data+16);
+	if ((stringTableOffset > (quint64)size) || (indexOffset > (quint64)size)) return false;
+
+	//String table
+	const uchar* end = data + size;
+	const uchar* ptr = data + stringTableOffset;
+	quint64 count,length;
+	if (!readVarint(&ptr,end,&count)) return false;
+	for (quint64 i = 0; i < count; i++) {
+		if (!readVarint(&ptr,end,&length)) return false;
+		if ((quint64)(end - ptr) < length) return false;
+		strings.append(QString::fromUtf8((const char*)ptr,length));
+		ptr += length;
+	}
+
+	//Sections index
+	ptr = data + indexOffset;
+	if (!readVarint(&ptr,end,&count)) return false;
+	if ((quint64)(end - ptr) < count*FWE_BINARY_SECTION_SIZE) return false;
+	for (quint64 i = 0; i < count; i++) {
+		Section section;
+		section.offset = qFromLittleEndian<quint64>(ptr+0);
+		section.length = qFromLittleEndian<quint64>(ptr+8);
+		section.name = qFromLittleEndian<quint32>(ptr+16);
+		section.type = qFromLittleEndian<quint32>(ptr+20);
+		if ((section.offset > (quint64)size) || (section.length > (quint64)size - section.offset)) return false;
+		sections.append(section);
+		ptr += FWE_BINARY_SECTION_SIZE;
+	}
+
+	//Root element
+	quint64 name;
+	ptr = data + FWE_BINARY_HEADER_SIZE;
+	if (!readVarint(&ptr,end,&name)) return false;
+	if (name >= (quint64)strings.count()) return false;
+	rootName = name;
+	return readAttributes(&ptr,end,&rootAttributes);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read file. It's mapped into memory, so sections are only read from
+///  disk when they are decoded.
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::read(const QString& fileName) {
+	clear();
+	file.setFileName(fileName);
+	if (!file.open(QIODevice::ReadOnly)) return false;
+
+	size = file.size();
+	data = file.map(0,size);
+	if (!data) {
+		buffer = file.readAll();
+		file.close();
+		if (buffer.size() != size) {
+			clear();
+			return false;
+		}
+		data = (const uchar*)buffer.constData();
+	}
+
+	if (!parse()) {
+		clear();
+		return false;
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::write(const QString& fileName) {
+	if (!data) return false;
+
+	QFile output(fileName);
+	if (!output.open(QIODevice::WriteOnly)) return false;
+	return output.write((const char*)data,size) == size;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool BinaryDocument::isBinaryFile(const QString& fileName) {
+	QFile input(fileName);
+	if (!input.open(QIODevice::ReadOnly)) return false;
+	return input.read(4) == FWE_BINARY_MAGIC;
+}
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_BINARY_H
+#define FWE_EVDS_BINARY_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QPair>
+
+QT_BEGIN_NAMESPACE
+class QXmlStreamReader;
+class QXmlStreamWriter;
+QT_END_NAMESPACE
+
+namespace EVDS {
+	//Binary container for EVDS documents. Holds the same elements as the XML
+	// description, with names and attribute values stored in a string table. Every
+	// top-level object is a separate section which can be decoded on its own.
+	class BinaryDocument {
+	public:
+		BinaryDocument();
+		~BinaryDocument();
+
+		//Encode XML description of the document
+		bool fromXML(const QByteArray& description);
+		//Decode a single section into XML description
+		QByteArray toXML(int section);
+
+		//Read file (mapped into memory if possible) or write document into file
+		bool read(const QString& fileName);
+		bool write(const QString& fileName);
+
+		//Top-level objects in the document
+		int getSectionCount() { return sections.count(); }
+
+		//Check if file contains a binary document
+		static bool isBinaryFile(const QString& fileName);
+
+	private:
+		struct Section {
+			quint64 offset;
+			quint64 length;
+			quint32 name;
+			quint32 type;
+		};
+
+		void clear();
+		QString getString(quint32 index) { return (index < (quint32)strings.count()) ? strings[index] : QString(); }
+
+		//Encoding
+		quint32 addString(const QString& str);
+		void writeVarint(quint64 value);
+		void writeText(const QString& str);
+		bool encodeElement(QXmlStreamReader* xml);
+
+		//Decoding
+		bool parse();
+		bool readVarint(const uchar** ptr, const uchar* end, quint64* value);
+		bool readAttributes(const uchar** ptr, const uchar* end, QList<QPair<quint32,quint32> >* attributes);
+		bool decodeNodes(QXmlStreamWriter* xml, const uchar* ptr, const uchar* end);
+		void writeRootStart(QXmlStreamWriter* xml);
+
+		//Contents of the file (either mapped or kept in memory)
+		QFile file;
+		QByteArray buffer;
+		const uchar* data;
+		qint64 size;
+
+		//String table and sections index
+		QStringList strings;
+		QHash<QString,quint32> stringIndices;
+		QList<Section> sections;
+
+		//Root element
+		quint32 rootName;
+		QList<QPair<quint32,quint32> > rootAttributes;
+	};
+}
+
+#endif
@@ -22,9 +22,31 @@
 #include "fwe_evds_object_renderer.h"
 #include "fwe_glscene.h"
 #include "fwe_evds_modifiers.h"
+#include "fwe_trace.h"
 
 using namespace EVDS;
 
+//Interned variable names
+static const VariableRef var_vector1_count("vector1.count");
+static const VariableRef var_vector2_count("vector2.count");
+static const VariableRef var_vector3_count("vector3.count");
+static const VariableRef var_circular_step("circular.step");
+static const VariableRef var_circular_radial_step("circular.radial_step");
+static const VariableRef var_circular_normal_step("circular.normal_step");
+static const VariableRef var_circular_arc_length("circular.arc_length");
+static const VariableRef var_circular_radius("circular.radius");
+static const VariableRef var_circular_rotate("circular.rotate");
+static const VariableRef var_vector1_x("vector1.x");
+static const VariableRef var_vector1_y("vector1.y");
+static const VariableRef var_vector1_z("vector1.z");
+static const VariableRef var_vector2_x("vector2.x");
+static const VariableRef var_vector2_y("vector2.y");
+static const VariableRef var_vector2_z("vector2.z");
+static const VariableRef var_vector3_x("vector3.x");
+static const VariableRef var_vector3_y("vector3.y");
+static const VariableRef var_vector3_z("vector3.z");
+static const VariableRef var_pattern("pattern");
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
@@ -65,6 +87,7 @@ ObjectModifiersManager::~ObjectModifiersManager() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectModifiersManager::updateModifiers() {
+	FWE_TRACE("ObjectModifiersManager::updateModifiers");
 	GLScene* glview = editor->getGLScene();
 
 	//Remove all instances from glview
@@ -85,17 +108,28 @@ void ObjectModifiersManager::updateModifiers() {
 	shouldUpdateModifiers = true;
 }
 
+int ObjectModifiersManager::getInstanceCount() {
+	int count = 0;
+	QMapIterator<Object*,QList<ObjectRendererModifierInstance> > iterator(modifierInstances);
+	while (iterator.hasNext()) {
+		iterator.next();
+		count += iterator.value().count();
+	}
+	return count;
+}
+
 void ObjectModifiersManager::doUpdateModifiers() {
 	if (!editor->getActive()) return;
 	if (!shouldUpdateModifiers) return;
 	shouldUpdateModifiers = false;
 	qDebug("ObjectModifiersManager::updateModifiers()");
+	FWE_TRACE("ObjectModifiersManager::doUpdateModifiers");
 
 	//Process all object starting from root
 	processUpdateModifiers(editor->getEditRoot());
 
 	//Update GL scene
-	editor->getGLScene()->update();
+	editor->getGLScene()->invalidate();
 }
 
 
@@ -109,7 +143,7 @@ void ObjectModifiersManager::processUpdateModifiers(Object* object) {
 	}
 
 	//If object is a modifier, create copies of its children
-	if (object->getType() == "modifier") {
+	if (object->getTypeId() == Object::TYPE_MODIFIER) {
 		for (int i = 0; i < object->getChildrenCount(); i++) {
 			createModifiedCopy(object,object->getChild(i));
 		}
@@ -132,7 +166,7 @@ void ObjectModifiersManager::processUpdatePosition(Object* object) {
 	}
 
 	//Set positions of all children
-	if (object->getType() == "modifier") {
+	if (object->getTypeId() == Object::TYPE_MODIFIER) {
 		for (int i = 0; i < modifierInstances[object].count(); i++) {
 			setInstancePosition(&modifierInstances[object][i]);
 		}
@@ -173,27 +207,27 @@ void ObjectModifiersManager::setInstancePosition(ObjectRendererModifierInstance*
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectModifiersManager::createModifiedCopy(Object* modifier, Object* object) {
 	//Get modifier information
-	int vector1_count = modifier->getVariable("vector1.count");
-	int vector2_count = modifier->getVariable("vector2.count");
-	int vector3_count = modifier->getVariable("vector3.count");
-	float circular_step = modifier->getVariable("circular.step");
-	float circular_radial_step = modifier->getVariable("circular.radial_step");
-	float circular_normal_step = modifier->getVariable("circular.normal_step");
-	float circular_arc_length = modifier->getVariable("circular.arc_length");
-	float circular_radius = modifier->getVariable("circular.radius");
-	float circular_rotate = modifier->getVariable("circular.rotate");
+	int vector1_count = modifier->getVariable(var_vector1_count);
+	int vector2_count = modifier->getVariable(var_vector2_count);
+	int vector3_count = modifier->getVariable(var_vector3_count);
+	float circular_step = modifier->getVariable(var_circular_step);
+	float circular_radial_step = modifier->getVariable(var_circular_radial_step);
+	float circular_normal_step = modifier->getVariable(var_circular_normal_step);
+	float circular_arc_length = modifier->getVariable(var_circular_arc_length);
+	float circular_radius = modifier->getVariable(var_circular_radius);
+	float circular_rotate = modifier->getVariable(var_circular_rotate);
 	QVector3D vector1 = QVector3D(
-		modifier->getVariable("vector1.x"),
-		modifier->getVariable("vector1.y"),
-		modifier->getVariable("vector1.z"));
+		modifier->getVariable(var_vector1_x),
+		modifier->getVariable(var_vector1_y),
+		modifier->getVariable(var_vector1_z));
 	QVector3D vector2 = QVector3D(
-		modifier->getVariable("vector2.x"),
-		modifier->getVariable("vector2.y"),
-		modifier->getVariable("vector2.z"));
+		modifier->getVariable(var_vector2_x),
+		modifier->getVariable(var_vector2_y),
+		modifier->getVariable(var_vector2_z));
 	QVector3D vector3 = QVector3D(
-		modifier->getVariable("vector3.x"),
-		modifier->getVariable("vector3.y"),
-		modifier->getVariable("vector3.z"));
+		modifier->getVariable(var_vector3_x),
+		modifier->getVariable(var_vector3_y),
+		modifier->getVariable(var_vector3_z));
 
 	//Make sure master copy remains
 	if (vector1_count < 1) vector1_count = 1;
@@ -212,7 +246,7 @@ void ObjectModifiersManager::createModifiedCopy(Object* modifier, Object* object
 			for (int k = 0; k < vector3_count; k++) {
 				//Create transformation
 				GLC_Matrix4x4 transformation;
-				if (modifier->getString("pattern") == "circular") {
+				if (modifier->getString(var_pattern) == "circular") {
 					//Get circle parameters
 					QVector3D normal = vector1;
 					QVector3D direction = vector2;
@@ -270,7 +304,7 @@ void ObjectModifiersManager::createModifiedCopy(Object* modifier, Object* object
 				modifierInstances[modifier].append(modifier_inst);
 
 				//Copy modifiers instances of the child to this modifier
-				if ((object->getType() == "modifier") && (object != modifier)) {
+				if ((object->getTypeId() == Object::TYPE_MODIFIER) && (object != modifier)) {
 					for (int j = 0; j < modifierInstances[object].count(); j++) {
 						ObjectRendererModifierInstance modifier_inst;
 						//Use the modified instance instead of original base instance
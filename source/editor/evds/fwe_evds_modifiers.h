@@ -61,6 +61,8 @@ namespace EVDS {
 
 		//Get modifier instances
 		QList<ObjectRendererModifierInstance>& getInstances(Object* object) { return modifierInstances[object]; }
+		//Get total number of instances created by all modifiers
+		int getInstanceCount();
 
 	private slots:
 		void doUpdateModifiers();
@@ -17,6 +17,7 @@
 /// along with this program.  If not, see http://www.gnu.org/licenses/.
 ////////////////////////////////////////////////////////////////////////////////
 #include <QString>
+#include <QTime>
 #include <math.h>
 
 #include "fwe_evds.h"
@@ -27,9 +28,277 @@
 #include "fwe_prop_sheet.h"
 #include "fwe_schematics.h"
 #include "fwe_schematics_renderer.h"
+#include "fwe_evds_residency.h"
+#include "fwe_trace.h"
 
 using namespace EVDS;
 
+//Interned variable names
+static const VariableRef var_fuel_type("fuel_type");
+static const VariableRef var_paper_format("paper.format");
+static const VariableRef var_paper_width("paper.width");
+static const VariableRef var_paper_height("paper.height");
+static const VariableRef var_paper_width_multiplier("paper.width_multiplier");
+static const VariableRef var_paper_height_multiplier("paper.height_multiplier");
+
+//Objects at this depth and deeper keep their children collapsed in large documents
+#define FWE_OBJECT_COLLAPSE_DEPTH	2
+//Information table which was published, but not yet taken by the GUI thread, is marked
+// in the lowest bit of the pointer
+#define FWE_INFORMATION_TAG(ptr)	((ObjectInformation*)((quintptr)(ptr) | 1))
+#define FWE_INFORMATION_UNTAG(ptr)	((ObjectInformation*)((quintptr)(ptr) & ~(quintptr)1))
+#define FWE_INFORMATION_IS_NEW(ptr)	((((quintptr)(ptr)) & 1) != 0)
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Table of interned variable names (shared by all threads)
+////////////////////////////////////////////////////////////////////////////////
+static QMutex& FWE_VariableRef_Lock() {
+	static QMutex lock;
+	return lock;
+}
+static QHash<QByteArray,int>& FWE_VariableRef_Indices() {
+	static QHash<QByteArray,int> indices;
+	return indices;
+}
+static QList<QByteArray>& FWE_VariableRef_Names() {
+	static QList<QByteArray> names;
+	return names;
+}
+
+VariableRef::VariableRef(const char* name) {
+	intern(QByteArray(name));
+}
+
+VariableRef::VariableRef(const QString& name) {
+	intern(name.toUtf8());
+}
+
+void VariableRef::intern(const QByteArray& name) {
+	QMutexLocker locker(&FWE_VariableRef_Lock());
+	QHash<QByteArray,int>::const_iterator i = FWE_VariableRef_Indices().constFind(name);
+	if (i != FWE_VariableRef_Indices().constEnd()) {
+		index = i.value();
+	} else {
+		index = FWE_VariableRef_Names().count();
+		FWE_VariableRef_Names().append(name);
+		FWE_VariableRef_Indices()[name] = index;
+	}
+}
+
+QByteArray VariableRef::getName() const {
+	QMutexLocker locker(&FWE_VariableRef_Lock());
+	return FWE_VariableRef_Names().at(index);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Table of variable values of all objects after a solve
+////////////////////////////////////////////////////////////////////////////////
+ObjectInformation::ObjectInformation() {
+	row_entries.append(0);
+	layout_changed = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read all values from the solved copy.
+///
+/// Table is updated in place. When the layout did not change since the table was
+/// last updated, only the values are written.
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInformation::update(EVDS_OBJECT* root) {
+	int row = 0;
+	int entry = 0;
+	layout_changed = false;
+	updateObject(root,&row,&entry);
+
+	//Remove rows and entries of objects which no longer exist
+	setRow(row,-1,entry);
+	if (row_uids.count() > row) {
+		row_uids.resize(row);
+		row_entries.resize(row+1);
+		layout_changed = true;
+	}
+	if (names.count() > entry) {
+		names.resize(entry);
+		vectors.resize(entry);
+		x.resize(entry);
+		y.resize(entry);
+		z.resize(entry);
+	}
+
+	//Rebuild index of rows
+	if (layout_changed) {
+		rows.clear();
+		for (int i = 0; i < row_uids.count(); i++) rows[row_uids.at(i)] = i;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInformation::updateObject(EVDS_OBJECT* object, int* row, int* entry) {
+	//Objects inside collapsed subtrees have no editor object and are never looked up
+	void* userdata;
+	EVDS_Object_GetUserdata(object,&userdata);
+	if (!userdata) return;
+
+	//UID was already set to editor UID before the solve
+	unsigned int uid;
+	EVDS_Object_GetUID(object,&uid);
+	setRow(*row,uid,*entry);
+	(*row)++;
+
+	//Scan all variables
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* list_entry;
+	EVDS_Object_GetVariables(object,&list);
+	list_entry = SIMC_List_GetFirst(list);
+	while (list_entry) {
+		EVDS_VARIABLE* variable = (EVDS_VARIABLE*)SIMC_List_GetData(list,list_entry);
+		list_entry = SIMC_List_GetNext(list,list_entry);
+
+		EVDS_VARIABLE_TYPE type;
+		EVDS_Variable_GetType(variable,&type);
+		if ((type != EVDS_VARIABLE_TYPE_FLOAT) && (type != EVDS_VARIABLE_TYPE_VECTOR)) continue;
+
+		//Find interned name without allocating a key
+		char name_str[65] = { 0 };
+		EVDS_Variable_GetName(variable,name_str,64);
+		int name;
+		QHash<QByteArray,int>::const_iterator i = 
+			name_indices.constFind(QByteArray::fromRawData(name_str,qstrlen(name_str)));
+		if (i != name_indices.constEnd()) {
+			name = i.value();
+		} else {
+			name = VariableRef(name_str).getIndex();
+			name_indices[QByteArray(name_str)] = name;
+		}
+
+		//Read value
+		EVDS_VECTOR value;
+		if (type == EVDS_VARIABLE_TYPE_FLOAT) {
+			EVDS_REAL real;
+			EVDS_Variable_GetReal(variable,&real);
+			value.x = real;
+			value.y = 0.0;
+			value.z = 0.0;
+		} else {
+			EVDS_Variable_GetVector(variable,&value);
+		}
+		setEntry(*entry,name,type == EVDS_VARIABLE_TYPE_VECTOR,value);
+		(*entry)++;
+	}
+
+	//Read children
+	EVDS_Object_GetAllChildren(object,&list);
+	list_entry = SIMC_List_GetFirst(list);
+	while (list_entry) {
+		updateObject((EVDS_OBJECT*)SIMC_List_GetData(list,list_entry),row,entry);
+		list_entry = SIMC_List_GetNext(list,list_entry);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInformation::setRow(int row, int editor_uid, int entry) {
+	if (row_entries.at(row) != entry) {
+		row_entries[row] = entry;
+		layout_changed = true;
+	}
+	if (editor_uid == -1) return; //End of the table
+
+	if ((row < row_uids.count()) && (row_uids.at(row) == editor_uid)) return;
+	row_uids.resize(row);
+	row_entries.resize(row+1);
+	row_uids.append(editor_uid);
+	row_entries.append(entry);
+	layout_changed = true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInformation::setEntry(int entry, int name, bool vector, const EVDS_VECTOR& value) {
+	if ((entry >= names.count()) || (names.at(entry) != name) || (vectors.at(entry) != vector)) {
+		names.resize(entry);
+		vectors.resize(entry);
+		x.resize(entry);
+		y.resize(entry);
+		z.resize(entry);
+		names.append(name);
+		vectors.append(vector);
+		x.append(0.0);
+		y.append(0.0);
+		z.append(0.0);
+	}
+	x[entry] = value.x;
+	y[entry] = value.y;
+	z[entry] = value.z;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+int ObjectInformation::findEntry(int editor_uid, int name) const {
+	QHash<int,int>::const_iterator i = rows.constFind(editor_uid);
+	if (i == rows.constEnd()) return -1;
+
+	int last = row_entries.at(i.value()+1);
+	for (int entry = row_entries.at(i.value()); entry < last; entry++) {
+		if (names.at(entry) == name) return entry;
+	}
+	return -1;
+}
+
+bool ObjectInformation::isDefined(int editor_uid, const VariableRef &ref) const {
+	return findEntry(editor_uid,ref.getIndex()) >= 0;
+}
+
+double ObjectInformation::getVariable(int editor_uid, const VariableRef &ref) const {
+	int entry = findEntry(editor_uid,ref.getIndex());
+	if ((entry < 0) || vectors.at(entry)) return 0.0;
+	return x.at(entry);
+}
+
+QVector3D ObjectInformation::getVector(int editor_uid, const VariableRef &ref) const {
+	int entry = findEntry(editor_uid,ref.getIndex());
+	if ((entry < 0) || (!vectors.at(entry))) return QVector3D();
+	return QVector3D(x.at(entry),y.at(entry),z.at(entry));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Estimate radius of the subtree from positions of the objects inside it
+////////////////////////////////////////////////////////////////////////////////
+static double FWE_Object_GetSubtreeRadius(EVDS_OBJECT* object) {
+	double radius = 0.0;
+
+	SIMC_LIST* list;
+	EVDS_Object_GetAllChildren(object,&list);
+	SIMC_LIST_ENTRY* entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		EVDS_OBJECT* child = (EVDS_OBJECT*)SIMC_List_GetData(list,entry);
+
+		//Position is relative to the parent object
+		EVDS_STATE_VECTOR vector;
+		EVDS_Object_GetStateVector(child,&vector);
+		double distance = sqrt(vector.position.x*vector.position.x +
+							   vector.position.y*vector.position.y +
+							   vector.position.z*vector.position.z);
+		radius = qMax(radius,distance + FWE_Object_GetSubtreeRadius(child));
+
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	return radius;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
@@ -40,6 +309,10 @@ Object::Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, FWE::EditorWindo
 	window = in_window;
 	parent = in_parent;
 
+	//Read name and type once, they only change through setName/setType
+	updateNameCache();
+	updateTypeCache();
+
 	//Is object initialized
 	int initialized;
 	EVDS_Object_IsInitialized(object,&initialized);
@@ -51,7 +324,7 @@ Object::Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, FWE::EditorWindo
 	renderer = 0;
 	if ((!initialized) && (in_parent)) {
 		QTime time; time.start();
-			renderer = new ObjectRenderer(this);
+			renderer = new (getEVDSEditor()->getLODScheduler()->getRendererPool()) ObjectRenderer(this);
 			window->updateObject(this);
 		int elapsed = time.elapsed();
 		if (elapsed > 40) {
@@ -59,8 +332,17 @@ Object::Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, FWE::EditorWindo
 		}
 	}
 
-	//Enumerate and store all children
-	if (!initialized) invalidateChildren();
+	//Enumerate and store all children (parts deep inside large documents are left collapsed)
+	collapsed = false;
+	collapsed_radius = 0.0;
+	if (!initialized) {
+		if (isCollapsible()) {
+			collapsed = true;
+			collapsed_radius = FWE_Object_GetSubtreeRadius(object);
+		} else {
+			invalidateChildren();
+		}
+	}
 
 	//No property sheet by default, no cross-sections editor
 	property_sheet = 0;
@@ -75,9 +357,10 @@ Object::Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, FWE::EditorWindo
 		renderer->meshChanged();
 		renderer->positionChanged();
 	}
+	if (collapsed) getEVDSEditor()->getResidencyManager()->collapsedObjectAdded(this);
 
-	//Add to modifiers
-	if (in_parent && window) {
+	//Add to modifiers (once for all objects if many are inserted at once)
+	if (in_parent && window && (!window->isBatchUpdate())) {
 		getEVDSEditor()->getModifiersManager()->objectAdded(this);
 		getSchematicsEditor()->getSchematicsRenderingManager()->updateInstances();
 	}
@@ -90,8 +373,11 @@ Object::Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, FWE::EditorWindo
 Object::~Object() {
 	//Only use this logic when EVDS editor still exists
 	if (window && getEVDSEditor()) {
-		getEVDSEditor()->getModifiersManager()->objectRemoved(this); //Signal object removal
-		getSchematicsEditor()->getSchematicsRenderingManager()->updateInstances();
+		if (!window->isBatchUpdate()) {
+			getEVDSEditor()->getModifiersManager()->objectRemoved(this); //Signal object removal
+			getSchematicsEditor()->getSchematicsRenderingManager()->updateInstances();
+		}
+		if (collapsed) getEVDSEditor()->getResidencyManager()->collapsedObjectRemoved(this);
 
 		if (getEVDSEditor()->getSelected() == this) getEVDSEditor()->clearSelection();
 	}
@@ -223,7 +509,26 @@ Object* Object::insertChild(int index, const QString &description) {
 	if (!info.firstObject) {
 		return insertNewChild(index);
 	}
+	return insertCreatedChild(index,new_object);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Insert copy of an EVDS object (must belong to the same system)
+////////////////////////////////////////////////////////////////////////////////
+Object* Object::insertCopy(int index, EVDS_OBJECT* source) {
+	EVDS_OBJECT* new_object;
+	if (EVDS_Object_Copy(source,object,&new_object) != EVDS_OK) {
+		return insertNewChild(index);
+	}
+	return insertCreatedChild(index,new_object);
+}
+
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Move new EVDS child object to the given index and create object for it
+////////////////////////////////////////////////////////////////////////////////
+Object* Object::insertCreatedChild(int index, EVDS_OBJECT* new_object) {
 	//Find head for this new object
 	int idx = 0;
 	SIMC_LIST* list;
@@ -245,9 +550,11 @@ Object* Object::insertChild(int index, const QString &description) {
 	//Move object into correct position in EVDS internal list
 	if (entry) EVDS_Object_MoveInList(new_object,head);
 
-	//Create object for it and add it to the children
+	//Create objects for the entire subtree, update modifiers and views once
+	if (window) window->beginBatchUpdate();
 	Object* new_object_obj = new Object(new_object,this,window);
 	children.insert(index,new_object_obj);
+	if (window) window->endBatchUpdate();
 	return new_object_obj;
 }
 
@@ -259,16 +566,15 @@ void Object::removeChild(int index) {
 	if (index < 0) return;
 	if (index >= children.count()) return;
 
+	//Whole subtree is removed at once, so modifiers and views are updated only once
+	if (window) window->beginBatchUpdate();
 	Object* child = children.at(index);
 	if (child) {
 		EVDS_Object_Destroy(child->object);
 	}
 	children.removeAt(index);
 	delete child;
-
-	if (window) {
-		window->updateObject(NULL);
-	}
+	if (window) window->endBatchUpdate();
 }
 
 
@@ -278,6 +584,7 @@ void Object::removeChild(int index) {
 void Object::invalidateChildren() {
 	//Delete all previous children entries
 	for (int i = 0; i < children.count(); i++) delete children[i];
+	children.clear();
 
 	//Re-build children list
 	SIMC_LIST* list;
@@ -294,33 +601,92 @@ void Object::invalidateChildren() {
 	}
 }
 
+
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief
+/// @brief Check if children of a newly created object should be left collapsed
 ////////////////////////////////////////////////////////////////////////////////
-QString Object::getName() {
+bool Object::isCollapsible() {
+	if ((!window) || (!parent)) return false;
+	if (!window->isLazyLoading()) return false;
+
+	//Modifiers, metadata and schematics must always be fully created
+	if ((type_id == TYPE_MODIFIER) || (type_id == TYPE_METADATA)) return false;
+	if (isSchematicsElement()) return false;
+	if (getCollapsedChildrenCount() == 0) return false;
+
+	//Only collapse objects deep enough in the hierarchy
+	int depth = 0;
+	for (Object* p = parent; p->getParent(); p = p->getParent()) depth++;
+	return depth >= FWE_OBJECT_COLLAPSE_DEPTH;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get number of EVDS children (also works for collapsed objects)
+////////////////////////////////////////////////////////////////////////////////
+int Object::getCollapsedChildrenCount() {
+	int count = 0;
+
+	SIMC_LIST* list;
+	EVDS_Object_GetAllChildren(object,&list);
+	SIMC_LIST_ENTRY* entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		count++;
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create editor objects for children of a collapsed object
+////////////////////////////////////////////////////////////////////////////////
+void Object::createChildren() {
+	if (!collapsed) return;
+	collapsed = false;
+	getEVDSEditor()->getResidencyManager()->collapsedObjectRemoved(this);
+	invalidateChildren();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read object name into cache
+////////////////////////////////////////////////////////////////////////////////
+void Object::updateNameCache() {
 	char name[257] = { 0 };
 	EVDS_Object_GetName(object,name,256);
-	return QString(name);
+	name_cache = QString(name);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief
+/// @brief Read object type into cache and resolve its identifier
 ////////////////////////////////////////////////////////////////////////////////
-void Object::setName(const QString &name) {
-	window->setModified();
-	EVDS_Object_SetName(object,name.toUtf8().data());
-	update(false);
+void Object::updateTypeCache() {
+	char type[257] = { 0 };
+	EVDS_Object_GetType(object,type,256);
+	type_cache = QString(type);
+
+	if (type_cache == "metadata")							type_id = TYPE_METADATA;
+	else if (type_cache == "modifier")						type_id = TYPE_MODIFIER;
+	else if (type_cache == "fuel_tank")						type_id = TYPE_FUEL_TANK;
+	else if (type_cache == "rocket_engine")					type_id = TYPE_ROCKET_ENGINE;
+	else if (type_cache == "foxworks.schematics")			type_id = TYPE_SCHEMATICS;
+	else if (type_cache == "foxworks.schematics.sheet")		type_id = TYPE_SCHEMATICS_SHEET;
+	else if (type_cache == "foxworks.schematics.element")	type_id = TYPE_SCHEMATICS_ELEMENT;
+	else													type_id = TYPE_OTHER;
+	schematics_element = type_cache.left(18) == "foxworks.schematic";
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-QString Object::getType() {
-	char type[257] = { 0 };
-	EVDS_Object_GetType(object,type,256);
-	return QString(type);
+void Object::setName(const QString &name) {
+	window->setModified(this);
+	EVDS_Object_SetName(object,name.toUtf8().data());
+	updateNameCache();
+	update(false);
 }
 
 
@@ -328,8 +694,9 @@ QString Object::getType() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setType(const QString &type) {
-	window->setModified();
+	window->setModified(this);
 	EVDS_Object_SetType(object,type.toUtf8().data());
+	updateTypeCache();
 	update(false);
 
 	getEVDSEditor()->getModifiersManager()->modifierChanged(this);
@@ -365,10 +732,10 @@ QWidget* Object::getPropertySheet() {
 				this, SLOT(propertyUpdate(const QString&)));
 
 		//Create default set of properties FIXME: make it less of a hack
-		if ((getType() != "metadata") && (!isSchematicsElement())) {
+		if ((type_id != TYPE_METADATA) && (!isSchematicsElement())) {
 			property_sheet->setProperties(window->objectVariables[""]);
 		}
-		if (isSchematicsElement() && (getType() != "foxworks.schematics.sheet")) {
+		if (isSchematicsElement() && (type_id != TYPE_SCHEMATICS_SHEET)) {
 			property_sheet->setProperties(window->objectVariables["foxworks.schematics"]);
 		}
 		if (!getType().isEmpty()) property_sheet->setProperties(window->objectVariables[getType()]);
@@ -381,6 +748,7 @@ QWidget* Object::getPropertySheet() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::doubleChanged(const QString& name, double value) {
+	FWE_TRACE("Object::doubleChanged");
 	setVariable(name,value);
 }
 
@@ -410,7 +778,7 @@ void Object::propertyUpdate(const QString& name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setVariable(const QString &name, double value) {
-	window->setModified();
+	window->setModified(this);
 
 	if (name[0] == '@') {
 		int specialIndex = name.right(1).toInt();
@@ -439,6 +807,8 @@ void Object::setVariable(const QString &name, double value) {
 		EVDS_VARIABLE* variable;
 		EVDS_Object_AddRealVariable(object,name.toAscii().data(),value,&variable);
 		EVDS_Variable_SetReal(variable,value);
+		variable_handles[VariableRef(name).getIndex()] = variable;
+		string_cache.remove(VariableRef(name).getIndex());
 		if ((name == "disable") ||
 			(name == "mass") ||
 			(name == "ixx") ||
@@ -459,7 +829,7 @@ void Object::setVariable(const QString &name, double value) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setVariable(const QString &name, const QString &value) {
-	getEVDSEditor()->setModified(name != "comments");
+	getEVDSEditor()->setModified(this,name != "comments");
 
 	if (name[0] == '@') {
 		int specialIndex = name.right(1).toInt();
@@ -482,6 +852,8 @@ void Object::setVariable(const QString &name, const QString &value) {
 		EVDS_VARIABLE* variable;
 		if (EVDS_Object_AddVariable(object,name.toAscii().data(),EVDS_VARIABLE_TYPE_STRING,&variable) == EVDS_OK) {
 			EVDS_Variable_SetString(variable,value.toAscii().data(),value.toAscii().count());
+			variable_handles[VariableRef(name).getIndex()] = variable;
+			string_cache.remove(VariableRef(name).getIndex());
 		}
 		if ((name != "comments") &&
 			(name != "text")) {
@@ -515,12 +887,7 @@ double Object::getVariable(const QString &name) {
 			case 8: return uid; break;
 		}
 	} else {
-		EVDS_VARIABLE* variable;
-		if (EVDS_Object_GetVariable(object,name.toUtf8().data(),&variable) == EVDS_OK) {
-			EVDS_REAL value;
-			EVDS_Variable_GetReal(variable,&value);
-			return value;
-		}
+		return getVariable(VariableRef(name));
 	}
 	return 0.0;
 }
@@ -530,13 +897,7 @@ double Object::getVariable(const QString &name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 QString Object::getString(const QString &name) {
-	EVDS_VARIABLE* variable;
-	if (EVDS_Object_GetVariable(object,name.toUtf8().data(),&variable) == EVDS_OK) {
-		char str[8192] = { 0 };
-		EVDS_Variable_GetString(variable,str,8191,0);
-		return QString(str);
-	}
-	return QString();
+	return getString(VariableRef(name));
 }
 
 
@@ -544,13 +905,7 @@ QString Object::getString(const QString &name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 QVector3D Object::getVector(const QString &name) {
-	EVDS_VARIABLE* variable;
-	if (EVDS_Object_GetVariable(object,name.toUtf8().data(),&variable) == EVDS_OK) {
-		EVDS_VECTOR value;
-		EVDS_Variable_GetVector(variable,&value);
-		return QVector3D(value.x,value.y,value.z);
-	}
-	return QVector3D();
+	return getVector(VariableRef(name));
 }
 
 
@@ -558,8 +913,80 @@ QVector3D Object::getVector(const QString &name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 bool Object::isVariableDefined(const QString &name) {
+	return isVariableDefined(VariableRef(name));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get variable handle, looking it up by name only on first access
+////////////////////////////////////////////////////////////////////////////////
+EVDS_VARIABLE* Object::getVariableHandle(const VariableRef &ref) {
+	QHash<int,EVDS_VARIABLE*>::const_iterator i = variable_handles.constFind(ref.getIndex());
+	if (i != variable_handles.constEnd()) return i.value();
+
 	EVDS_VARIABLE* variable;
-	return EVDS_Object_GetVariable(object,name.toUtf8().data(),&variable) == EVDS_OK;
+	if (EVDS_Object_GetVariable(object,ref.getName().data(),&variable) != EVDS_OK) {
+		variable = 0;
+	}
+	variable_handles[ref.getIndex()] = variable;
+	return variable;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool Object::isVariableDefined(const VariableRef &ref) {
+	return getVariableHandle(ref) != 0;
+}
+
+double Object::getVariable(const VariableRef &ref) {
+	EVDS_VARIABLE* variable = getVariableHandle(ref);
+	if (variable) {
+		EVDS_REAL value;
+		EVDS_Variable_GetReal(variable,&value);
+		return value;
+	}
+	return 0.0;
+}
+
+QString Object::getString(const VariableRef &ref) {
+	QHash<int,QString>::const_iterator i = string_cache.constFind(ref.getIndex());
+	if (i != string_cache.constEnd()) return i.value();
+
+	EVDS_VARIABLE* variable = getVariableHandle(ref);
+	if (!variable) return QString();
+
+	//Short strings are read into a small buffer, longer ones until they fit
+	char str[256];
+	size_t length = 0;
+	QString value;
+	if (EVDS_Variable_GetString(variable,str,sizeof(str),&length) != EVDS_OK) return QString();
+	if (length < sizeof(str)) {
+		value = QString::fromAscii(str,qstrnlen(str,length));
+	} else {
+		QByteArray buffer;
+		int size = sizeof(str);
+		do {
+			size *= 2;
+			buffer.resize(size);
+			EVDS_Variable_GetString(variable,buffer.data(),size,&length);
+		} while (length >= (size_t)size);
+		value = QString::fromAscii(buffer.constData(),qstrnlen(buffer.constData(),length));
+	}
+
+	string_cache[ref.getIndex()] = value;
+	return value;
+}
+
+QVector3D Object::getVector(const VariableRef &ref) {
+	EVDS_VARIABLE* variable = getVariableHandle(ref);
+	if (variable) {
+		EVDS_VECTOR value;
+		EVDS_Variable_GetVector(variable,&value);
+		return QVector3D(value.x,value.y,value.z);
+	}
+	return QVector3D();
 }
 
 
@@ -567,7 +994,7 @@ bool Object::isVariableDefined(const QString &name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 bool Object::isOxidizerTank() {
-	QString fuel_type = getString("fuel_type");
+	QString fuel_type = getString(var_fuel_type);
 	if (fuel_type != "") {
 		EVDS_SYSTEM* system;
 		EVDS_VARIABLE* database;
@@ -588,19 +1015,11 @@ bool Object::isOxidizerTank() {
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-/// @brief
-////////////////////////////////////////////////////////////////////////////////
-bool Object::isSchematicsElement() { 
-	return getType().left(18) == "foxworks.schematic";
-}
-
-
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::getSheetPaperSizeInCM(float* width, float* height) {
-	QString format = getString("paper.format");
+	QString format = getString(var_paper_format);
 	if (format == "") format = "a4";
 	double fw = 29.7;
 	double fh = 21.0;
@@ -618,13 +1037,13 @@ void Object::getSheetPaperSizeInCM(float* width, float* height) {
 		fh = 118.9;
 	}
 
-	double w = getVariable("paper.width");
-	double h = getVariable("paper.height");
+	double w = getVariable(var_paper_width);
+	double h = getVariable(var_paper_height);
 	if (w <= 0.0) w = fw;
 	if (h <= 0.0) h = fh;
 
-	double wm = getVariable("paper.width_multiplier");
-	double hm = getVariable("paper.height_multiplier");
+	double wm = getVariable(var_paper_width_multiplier);
+	double hm = getVariable(var_paper_height_multiplier);
 	if (wm > 1.0) w *= wm;
 	if (hm > 1.0) h *= hm;
 
@@ -662,7 +1081,8 @@ void Object::deleteCrossSectionsEditor() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::update(bool visually) {
-	if (getType() == "metadata") return; //Do not do any updates for metadata
+	FWE_TRACE("Object::update");
+	if (type_id == TYPE_METADATA) return; //Do not do any updates for metadata
 
 	if (renderer) {
 		if (visually) {
@@ -685,60 +1105,18 @@ void Object::update(bool visually) {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief
+/// @brief Read information from the table published by the last solve
 ////////////////////////////////////////////////////////////////////////////////
-void Object::recursiveUpdateInformation(ObjectInitializer* initializer) {
-	//Update information about the current object
-	TemporaryObject* temporary_object = initializer->getObject(this);
-	EVDS_OBJECT* evds_object = temporary_object->getEVDSObject();
-
-	SIMC_LIST* list;
-	SIMC_LIST_ENTRY* entry;
-
-	//Scan all variables
-	EVDS_Object_GetVariables(evds_object,&list);
-	entry = SIMC_List_GetFirst(list);
-	while (entry) {
-		EVDS_VARIABLE* variable = (EVDS_VARIABLE*)SIMC_List_GetData(list,entry);
-
-		//Get name and type to fill out info_vectors/info_variables arrays
-		char name_str[65] = { 0 };
-		EVDS_VARIABLE_TYPE type;
-		EVDS_Variable_GetName(variable,name_str,64);
-		EVDS_Variable_GetType(variable,&type);
-
-		QString name(name_str);
-		if (type == EVDS_VARIABLE_TYPE_FLOAT) { //Floating point var
-			info_variables[name] = temporary_object->getVariable(name);
-		} else if (type == EVDS_VARIABLE_TYPE_VECTOR) { //Vector var
-			info_vectors[name] = temporary_object->getVector(name);
-		}
-
-		info_defined[name] = temporary_object->isVariableDefined(name);
-		entry = SIMC_List_GetNext(list,entry);
-	}
-
-	delete temporary_object;
-
-	//Update information for all children
-	for (int i = 0; i < getChildrenCount(); i++) {
-		getChild(i)->recursiveUpdateInformation(initializer);
-	}
-}
-
 double Object::getInformationVariable(const QString &name) {
-	if (!info_variables.contains(name)) return 0.0;
-	return info_variables[name];
+	return getEVDSEditor()->getInitializer()->getInformation()->getVariable(editor_uid,VariableRef(name));
 }
 
 QVector3D Object::getInformationVector(const QString &name) {
-	if (!info_vectors.contains(name)) return QVector3D();
-	return info_vectors[name];
+	return getEVDSEditor()->getInitializer()->getInformation()->getVector(editor_uid,VariableRef(name));
 }
 
 bool Object::isInformationDefined(const QString &name) {
-	if (!info_defined.contains(name)) return false;
-	return info_defined[name];
+	return getEVDSEditor()->getInitializer()->getInformation()->isDefined(editor_uid,VariableRef(name));
 }
 
 
@@ -752,6 +1130,13 @@ ObjectInitializer::ObjectInitializer(Object* in_object) {
 
 	//Initialize temporary object
 	object_copy = 0;
+	for (int i = 0; i < 2; i++) {
+		snapshots[i].root = 0;
+		snapshots[i].invalid = false;
+	}
+	publishedSnapshot = -1;
+	solverSnapshot = -1;
+	lastSnapshot = 0;
 
 	//Temporary hack to check in_object for validity
 	in_object->getType(); //Will crash when in_object is invalid
@@ -759,12 +1144,26 @@ ObjectInitializer::ObjectInitializer(Object* in_object) {
 	//Delete thread when work is finished
 	connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));	
 	connect(&updateCallTimer, SIGNAL(timeout()), this, SLOT(doUpdateObject()));
+	lastSolveTime = -1;
+	solverInformation = new ObjectInformation();
+	publishedInformation = new ObjectInformation();
+	information = new ObjectInformation();
 	doStopWork = false;
 	needObject = false; 
 	objectCompleted = true;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+ObjectInitializer::~ObjectInitializer() {
+	delete solverInformation;
+	delete FWE_INFORMATION_UNTAG(publishedInformation.fetchAndStoreAcquire(0));
+	delete information;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -772,39 +1171,85 @@ TemporaryObject* ObjectInitializer::getObject(Object* object) {
 	while (!objectCompleted) msleep(1); //Wait until object initialization is completed
 
 	readingLock.lock();
-	EVDS_OBJECT* found_object = 0;
-	EVDS_SYSTEM* system;
-	EVDS_Object_GetSystem(object_copy,&system);
-	if (EVDS_System_GetObjectByUID(system,object_copy,object->getEditorUID(),&found_object) != EVDS_OK) {
+	EVDS_OBJECT* found_object = initialized_objects.value(object->getEditorUID());
+	if (!found_object) {
 		qWarning("ObjectInitializer::getObject: could not find object");
-		return new TemporaryObject(object_copy,0);
+		return new TemporaryObject(object_copy,&readingLock);
 	}
 	return new TemporaryObject(found_object,&readingLock);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Get a temporary copy of the object
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+const ObjectInformation* ObjectInitializer::getInformation() {
+	//Exchange the table which was read before for the one published by the solver thread
+	// (only the solver thread publishes tagged tables, so the exchanged table is always new)
+	if (FWE_INFORMATION_IS_NEW((ObjectInformation*)publishedInformation)) {
+		information = FWE_INFORMATION_UNTAG(publishedInformation.fetchAndStoreAcquire(information));
+	}
+	return information;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bring snapshot of the vessel up to date and hand it over to the solver thread
 ///
 /// Must be called before the first call of getObject!
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectInitializer::doUpdateObject() {
+	FWE_TRACE("ObjectInitializer::copyObject");
 	updateCallTimer.stop();
 	//qDebug("ObjectInitializer::doUpdateObject: fire!");
-	needObject = true;
 	if (this->isRunning()) {
-		readingLock.lock();
-			//Destroy old copy of initialized object
-			if (object_copy) EVDS_Object_Destroy(object_copy);
-			//Create new one
+		//Take back the snapshot solver did not pick up yet, otherwise the one it's not copying
+		int index;
+		snapshotLock.lock();
+			if (publishedSnapshot >= 0) {
+				index = publishedSnapshot;
+				publishedSnapshot = -1;
+			} else if (solverSnapshot >= 0) {
+				index = 1 - solverSnapshot;
+			} else {
+				index = lastSnapshot;
+			}
+		snapshotLock.unlock();
+
+		//Snapshot may have been copied by the solver thread last time
+		Snapshot* target = &snapshots[index];
+		if (target->root) EVDS_Object_TransferInitialization(target->root);
+
+		//Copy only the changed objects if structure of the vessel is the same
+		if (target->root && (!target->invalid)) {
+			QSetIterator<Object*> i(target->changed_objects);
+			while (i.hasNext() && (!target->invalid)) {
+				if (!updateSnapshotObject(target,i.next())) target->invalid = true;
+			}
+		}
+
+		//Copy entire vessel
+		if ((!target->root) || target->invalid) {
+			if (target->root) EVDS_Object_Destroy(target->root);
+			target->objects.clear();
+
 			EVDS_OBJECT* inertial_root;
 			EVDS_SYSTEM* system;
 			EVDS_Object_GetSystem(object->getEVDSObject(),&system);
 			EVDS_System_GetRootInertialSpace(system,&inertial_root);
-			EVDS_Object_Copy(object->getEVDSObject(),inertial_root,&object_copy);
-			//Object not completed
+			EVDS_Object_Copy(object->getEVDSObject(),inertial_root,&target->root);
+			indexSnapshot(target,target->root);
+		}
+		target->changed_objects.clear();
+		target->invalid = false;
+		lastSnapshot = index;
+
+		//Hand snapshot over, object not completed
+		snapshotLock.lock();
+			publishedSnapshot = index;
+			needObject = true;
 			objectCompleted = false;
-		readingLock.unlock();
+		snapshotLock.unlock();
 	}
 }
 
@@ -819,19 +1264,114 @@ void ObjectInitializer::updateObject() {
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object) {
+void ObjectInitializer::objectChanged(Object* changed) {
+	//Both snapshots must receive the change (snapshots are only used by the GUI thread here)
+	for (int i = 0; i < 2; i++) {
+		if (!snapshots[i].invalid) snapshots[i].changed_objects.insert(changed);
+	}
+	updateObject();
+}
+
+void ObjectInitializer::structureChanged() {
+	//Changed objects may be removed, they will be copied anyway
+	for (int i = 0; i < 2; i++) {
+		snapshots[i].changed_objects.clear();
+		snapshots[i].invalid = true;
+	}
+	updateObject();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Replace copy of the changed object in the snapshot, keeping its children
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectInitializer::updateSnapshotObject(Snapshot* target, Object* changed) {
+	//Objects outside of the vessel are not part of the snapshot
+	Object* vessel_object = changed;
+	while (vessel_object && (vessel_object != object)) vessel_object = vessel_object->getParent();
+	if (!vessel_object) return true;
+
+	//Root is only copied together with the rest of the vessel
+	if (changed == object) return false;
+	EVDS_OBJECT* old_object = target->objects.value(changed->getEditorUID());
+	EVDS_OBJECT* parent = target->objects.value(changed->getParent()->getEditorUID());
+	if ((!old_object) || (!parent)) return false;
+
+	//Find object which precedes the old copy
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+	EVDS_OBJECT* head = 0;
+	EVDS_Object_GetAllChildren(parent,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		EVDS_OBJECT* child = (EVDS_OBJECT*)SIMC_List_GetData(list,entry);
+		if (child == old_object) break;
+		head = child;
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	SIMC_List_Stop(list,entry);
+	if (!entry) return false;
+
+	//Create new copy in the same place
+	EVDS_OBJECT* new_object;
+	EVDS_Object_CopySingle(changed->getEVDSObject(),parent,&new_object);
+	EVDS_Object_SetUserdata(new_object,changed);
+	EVDS_Object_MoveInList(new_object,head);
+
+	//Move children of the old copy (they are updated separately if changed)
+	QList<EVDS_OBJECT*> children;
+	EVDS_Object_GetAllChildren(old_object,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		children.append((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	for (int i = 0; i < children.count(); i++) {
+		EVDS_Object_SetParent(children[i],new_object);
+	}
+
+	EVDS_Object_Destroy(old_object);
+	target->objects[changed->getEditorUID()] = new_object;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInitializer::indexSnapshot(Snapshot* target, EVDS_OBJECT* snapshot_object) {
+	//Objects inside collapsed subtrees have no editor object and are never changed
+	void* userdata;
+	EVDS_Object_GetUserdata(snapshot_object,&userdata);
+	if (!userdata) return;
+	target->objects[static_cast<Object*>(userdata)->getEditorUID()] = snapshot_object;
+
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+	EVDS_Object_GetAllChildren(snapshot_object,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		indexSnapshot(target,(EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		entry = SIMC_List_GetNext(list,entry);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Set editor UIDs in the copy and add its objects into the index
+////////////////////////////////////////////////////////////////////////////////
+void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object, QHash<int,EVDS_OBJECT*>* index) {
 	//Get userdata
 	void* userdata;
 	EVDS_Object_GetUserdata(object,&userdata);
 	Object* editor_object = static_cast<Object*>(userdata);
 
-	if (!editor_object) {
-		qDebug("FWE_ObjectInitializer_FixUIDs: for some reason no UID");
-		return;
-	}
+	//Objects inside collapsed subtrees have no editor object and are never looked up
+	if (!editor_object) return;
 
 	//Set UID
 	EVDS_Object_SetUID(object,editor_object->getEditorUID());
+	index->insert(editor_object->getEditorUID(),object);
 
 	//Get list of children
 	SIMC_LIST* list;
@@ -841,7 +1381,7 @@ void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object) {
 	//Do same for every child
 	entry = SIMC_List_GetFirst(list);
 	while (entry) {
-		FWE_ObjectInitializer_FixUIDs((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		FWE_ObjectInitializer_FixUIDs((EVDS_OBJECT*)SIMC_List_GetData(list,entry),index);
 		entry = SIMC_List_GetNext(list,entry);
 	}
 }
@@ -866,21 +1406,59 @@ void ObjectInitializer::run() {
 	object->getEditorWindow()->threadStarted();
 
 	msleep(2000); //Give enough time for the rest of application to initialize
-	while (!object_copy && (!doStopWork)) msleep(100); //Wait until there's an object to initialize
+	while (!needObject && (!doStopWork)) msleep(100); //Wait until there's an object to initialize
 	while (!doStopWork) {
+		//Take the published snapshot, GUI thread will update the other one meanwhile
+		int index = -1;
 		if (needObject) {
+			snapshotLock.lock();
+				index = publishedSnapshot;
+				if (index >= 0) {
+					needObject = false;
+					publishedSnapshot = -1;
+					solverSnapshot = index;
+				}
+			snapshotLock.unlock();
+		}
+
+		if (index >= 0) {
+			FWE_TRACE("ObjectInitializer::solve");
+			QTime solveTime;
 			readingLock.lock();
-				//Start making the mesh
-				needObject = false;
+				solveTime.start();
+
+				//Replace copy from the previous solve with a copy of the snapshot. Snapshot
+				// was updated by the GUI thread, so get rights to it first
+				if (object_copy) EVDS_Object_Destroy(object_copy);
+				EVDS_Object_TransferInitialization(snapshots[index].root);
+
+				EVDS_OBJECT* inertial_root;
+				EVDS_SYSTEM* system;
+				EVDS_Object_GetSystem(snapshots[index].root,&system);
+				EVDS_System_GetRootInertialSpace(system,&inertial_root);
+				EVDS_Object_Copy(snapshots[index].root,inertial_root,&object_copy);
+
+				//Snapshot can be updated by the GUI thread again
+				snapshotLock.lock();
+					solverSnapshot = -1;
+				snapshotLock.unlock();
 
 				//Transfer and initialize object
 				//qDebug("ObjectInitializer::run: initializing...");
 				EVDS_Object_TransferInitialization(object_copy); //Get rights to work with variables
-				FWE_ObjectInitializer_FixUIDs(object_copy); //Fix UID's for the objects
+				initialized_objects.clear();
+				FWE_ObjectInitializer_FixUIDs(object_copy,&initialized_objects); //Fix UID's for the objects
 				EVDS_Object_Initialize(object_copy,1);
 				EVDS_Object_Solve(object_copy,0.0);
+				lastSolveTime = solveTime.elapsed();
 				//qDebug("ObjectInitializer::run: done!");
 
+				//Read information in place and publish the table. Solver continues with the
+				// table that was published before (or returned by the GUI thread)
+				solverInformation->update(object_copy);
+				solverInformation = FWE_INFORMATION_UNTAG(
+					publishedInformation.fetchAndStoreOrdered(FWE_INFORMATION_TAG(solverInformation)));
+
 				//Finish working
 				objectCompleted = true;
 			readingLock.unlock();
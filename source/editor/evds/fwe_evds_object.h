@@ -25,7 +25,10 @@
 #include <QThread>
 #include <QMutex>
 #include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QTimer>
+#include <QAtomicPointer>
 
 #include "evds.h"
 #include "fwe_editor.h"
@@ -41,10 +44,76 @@ namespace EVDS {
 	class ObjectRenderer;
 	class ObjectInitializer;
 	class CrossSectionEditor;
+
+	//Interned name of an object variable. Objects cache variable handles by it, so
+	// reading a variable by reference does not convert strings or search lists.
+	class VariableRef {
+	public:
+		explicit VariableRef(const char* name);
+		explicit VariableRef(const QString& name);
+
+		int getIndex() const { return index; }
+		QByteArray getName() const;
+
+	private:
+		void intern(const QByteArray& name);
+		int index;
+	};
+
+	//Values of numeric variables of all objects in a solved copy of the vessel. Every object
+	// is a row of entries (one per variable) stored in flat arrays
+	class ObjectInformation {
+	public:
+		ObjectInformation();
+
+		//Read values from the solved copy (layout of the table is reused when unchanged)
+		void		update(EVDS_OBJECT* root);
+
+		bool		isDefined(int editor_uid, const VariableRef &ref) const;
+		double		getVariable(int editor_uid, const VariableRef &ref) const;
+		QVector3D	getVector(int editor_uid, const VariableRef &ref) const;
+
+	private:
+		//Read values of the object and its children into rows starting from the given one
+		void updateObject(EVDS_OBJECT* object, int* row, int* entry);
+		//Start new row or check that the existing one matches
+		void setRow(int row, int editor_uid, int entry);
+		//Write value into an entry, checking that the existing entry matches
+		void setEntry(int entry, int name, bool vector, const EVDS_VECTOR& value);
+		//Find entry for the variable (-1 if not defined)
+		int findEntry(int editor_uid, int name) const;
+
+		//Rows
+		QHash<int,int> rows; //Row by editor UID
+		QVector<int> row_uids;
+		QVector<int> row_entries; //First entry of every row (and end of the last one)
+		bool layout_changed;
+
+		//Entries
+		QVector<int> names; //Interned variable name
+		QVector<bool> vectors; //Is entry a vector
+		QVector<double> x,y,z; //Value is stored in x
+
+		//Interned names by EVDS variable name (only used by the solver thread)
+		QHash<QByteArray,int> name_indices;
+	};
+
 	class Object : public QObject {
 		Q_OBJECT
 
 	public:
+		//Object types which the editor checks for (others are reported as TYPE_OTHER)
+		enum ObjectType {
+			TYPE_OTHER,
+			TYPE_METADATA,
+			TYPE_MODIFIER,
+			TYPE_FUEL_TANK,
+			TYPE_ROCKET_ENGINE,
+			TYPE_SCHEMATICS,
+			TYPE_SCHEMATICS_SHEET,
+			TYPE_SCHEMATICS_ELEMENT,
+		};
+
 		Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, FWE::EditorWindow* in_window);
 		~Object();
 
@@ -55,11 +124,20 @@ namespace EVDS {
 		double		getVariable(const QString &name);
 		QString		getString(const QString &name);
 		QVector3D	getVector(const QString &name);
-		QString		getName();
+		QString		getName() { return name_cache; }
 		void		setName(const QString &name);
-		QString		getType();
+		QString		getType() { return type_cache; }
+		ObjectType	getTypeId() { return type_id; }
 		void		setType(const QString &type);
 
+		//Variable reading by interned name (special "@" variables are not supported)
+		bool		isVariableDefined(const VariableRef &ref);
+		double		getVariable(const VariableRef &ref);
+		QString		getString(const VariableRef &ref);
+		QVector3D	getVector(const VariableRef &ref);
+		//Forget cached variable handles and strings (call after changing variables directly)
+		void		invalidateVariables() { variable_handles.clear(); string_cache.clear(); }
+
 		//Children management
 		Object*	getParent() { return parent; }
 		int		getChildrenCount() { return children.count(); }
@@ -68,12 +146,20 @@ namespace EVDS {
 		Object*	insertNewChild(int index);
 		Object*	appendHiddenChild();
 		Object*	insertChild(int index, const QString &description);
+		Object*	insertCopy(int index, EVDS_OBJECT* source);
 		void	removeChild(int index);
 		void	hideChild(int index);
 		void	invalidateChildren();
 
+		//Children of collapsed objects exist only as EVDS objects until they are needed
+		// (use EditorWindow::createChildren so views are updated as well)
+		bool	isCollapsed() { return collapsed; }
+		int		getCollapsedChildrenCount();
+		double	getCollapsedRadius() { return collapsed_radius; }
+		void	createChildren();
+
 		//Object-specific functions
-		bool isSchematicsElement();
+		bool isSchematicsElement() { return schematics_element; }
 		bool isOxidizerTank();
 		void getSheetPaperSizeInCM(float* width, float* height);
 
@@ -95,8 +181,7 @@ namespace EVDS {
 		//Update model or parameters
 		void update(bool visually); 
 
-		//Information
-		void		recursiveUpdateInformation(ObjectInitializer* initializer);
+		//Information from the last solve
 		double		getInformationVariable(const QString &name);
 		QVector3D	getInformationVector(const QString &name);
 		bool		isInformationDefined(const QString &name);
@@ -108,10 +193,30 @@ namespace EVDS {
 		void meshReady();
 
 	private:
+		//Read name and type of the EVDS object into cache
+		void updateNameCache();
+		void updateTypeCache();
+		//Place new EVDS child at the index and create object for it
+		Object* insertCreatedChild(int index, EVDS_OBJECT* new_object);
+
+		//Should children be left collapsed when object is created
+		bool isCollapsible();
+		bool collapsed;
+		double collapsed_radius; //Estimated radius of the collapsed subtree
+
+		//Cached name and type
+		QString name_cache;
+		QString type_cache;
+		ObjectType type_id;
+		bool schematics_element;
+
+		//Get variable handle for reference (0 if not defined)
+		EVDS_VARIABLE* getVariableHandle(const VariableRef &ref);
+		QHash<int,EVDS_VARIABLE*> variable_handles;
+		//Values of string variables which were already read
+		QHash<int,QString> string_cache;
+
 		int editor_uid;
-		QHash<QString,QVector3D> info_vectors;
-		QHash<QString,double> info_variables;
-		QHash<QString,bool> info_defined;
 
 		EVDS_OBJECT* object;
 		FWE::EditorWindow* window;
@@ -147,9 +252,14 @@ namespace EVDS {
 
 	public:
 		ObjectInitializer(Object* in_object);
+		~ObjectInitializer();
 
 		//Re-initialize object
 		void updateObject();
+		//Object was changed, only its part of the snapshot is copied again
+		void objectChanged(Object* changed);
+		//Objects were inserted or removed, entire vessel is copied again
+		void structureChanged();
 		//Abort thread work
 		void stopWork();
 		//Locked when object is still inconsistent or when it's being read
@@ -157,6 +267,10 @@ namespace EVDS {
 
 		//Get temporary object for a real object (by unique identifier)
 		TemporaryObject* getObject(Object* object);
+		//Time taken by the last initialization and solve in msec (-1 if not done yet)
+		int getLastSolveTime() { return lastSolveTime; }
+		//Get information from the last solve (GUI thread only, valid until the next call)
+		const ObjectInformation* getInformation();
 
 	public slots:
 		void doUpdateObject();
@@ -172,9 +286,38 @@ namespace EVDS {
 		bool doStopWork; //Stop threads work
 		bool needObject; //Is new object required
 		bool objectCompleted; //Is object ready to be read
+		int lastSolveTime; //Time taken by the last solve
+
+		//Three information tables: solver thread fills one, GUI thread reads another, and
+		// the third one is exchanged between them. Tables are never copied
+		ObjectInformation* solverInformation;
+		QAtomicPointer<ObjectInformation> publishedInformation; //Tagged if GUI thread did not take it yet
+		ObjectInformation* information;
 
 		Object* object; //Object which is initialized
 		EVDS_OBJECT* object_copy;
+		QHash<int,EVDS_OBJECT*> initialized_objects; //Objects of the copy by editor UID
+
+		//Uninitialized copy of the vessel kept up to date by the GUI thread
+		struct Snapshot {
+			EVDS_OBJECT* root;
+			QHash<int,EVDS_OBJECT*> objects; //Objects of the snapshot by editor UID
+			QSet<Object*> changed_objects; //Objects changed since the snapshot was updated
+			bool invalid; //Structure has changed since the snapshot was made
+		};
+
+		//Copy changed object into the snapshot (returns false if entire vessel must be copied)
+		bool updateSnapshotObject(Snapshot* target, Object* changed);
+		//Add objects of the snapshot into the index
+		void indexSnapshot(Snapshot* target, EVDS_OBJECT* snapshot_object);
+
+		//GUI thread updates one snapshot while solver thread copies the other one. Only
+		// handing a snapshot over is done under the lock, so edits never wait for a copy
+		QMutex snapshotLock;
+		Snapshot snapshots[2];
+		int publishedSnapshot; //Snapshot ready for the solver thread (-1 if none)
+		int solverSnapshot; //Snapshot being copied by the solver thread (-1 if none)
+		int lastSnapshot; //Snapshot which was updated last (GUI thread only)
 	};
 }
 
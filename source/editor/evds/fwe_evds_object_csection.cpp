@@ -65,6 +65,7 @@ CrossSectionEditor::CrossSectionEditor(Object* in_object) {
 	geometry = 0;
 	if (EVDS_Object_GetVariable(object->getEVDSObject(),"geometry.cross_sections",&geometry) != EVDS_OK) {
 		EVDS_Object_AddVariable(object->getEVDSObject(),"geometry.cross_sections",EVDS_VARIABLE_TYPE_NESTED,&geometry);
+		object->invalidateVariables();
 	}
 	EVDS_Variable_GetList(geometry,&csections_list);
 
@@ -126,7 +127,7 @@ void CrossSectionEditor::sectionSelected(int index) {
 		//Update geometry, unless this is the first cross-section to be created
 		if (index != 0) {
 			object->update(true);
-			object->getEVDSEditor()->setModified();
+			object->getEVDSEditor()->setModified(object);
 		}
 	}
 	sections->setCurrentIndex(index);
@@ -162,7 +163,7 @@ void CrossSectionEditor::sectionDeleted(int index) {
 
 	//Update geometry
 	object->update(true);
-	object->getEVDSEditor()->setModified();
+	object->getEVDSEditor()->setModified(object);
 }
 
 
@@ -199,7 +200,7 @@ void CrossSectionEditor::sectionMoved(int from, int to) {
 
 	//Update geometry
 	object->update(true);
-	object->getEVDSEditor()->setModified();
+	object->getEVDSEditor()->setModified(object);
 }
 
 
@@ -317,7 +318,7 @@ void CrossSection::setVariable(const QString &name, double value) {
 		}
 	}
 	editor->getObject()->update(true);
-	editor->getObject()->getEVDSEditor()->setModified();
+	editor->getObject()->getEVDSEditor()->setModified(editor->getObject());
 }
 
 
@@ -342,13 +343,14 @@ void CrossSection::setVariable(const QString &name, const QString &value) {
 				//editor->propertySheetUpdated(prev_sheet,property_sheet);
 			}
 			editor->getObject()->update(true);
+			editor->getObject()->getEVDSEditor()->setModified(editor->getObject());
 			return;
 		}
 	} else {
 		//FIXME
 	}
 	editor->getObject()->update(true);
-	editor->getObject()->getEVDSEditor()->setModified();
+	editor->getObject()->getEVDSEditor()->setModified(editor->getObject());
 }
 
 
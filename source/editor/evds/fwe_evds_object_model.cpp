@@ -23,6 +23,13 @@
 
 using namespace EVDS;
 
+//Interned variable names
+static const VariableRef var_pattern("pattern");
+static const VariableRef var_disable("disable");
+
+//Type of the object which holds several dragged or copied objects
+#define FWE_OBJECT_LIST_TYPE	"foxworks.object_list"
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
@@ -32,6 +39,10 @@ ObjectTreeModel::ObjectTreeModel(FWE::EditorWindow* in_window, EVDS::Object* in_
 	window = in_window;
 	root = in_root;
 	acceptedMimeType = "application/vnd.evds+xml";
+
+	connect(window, SIGNAL(childrenAboutToBeCreated(EVDS::Object*,int)), 
+		this, SLOT(childrenAboutToBeCreated(EVDS::Object*,int)));
+	connect(window, SIGNAL(childrenCreated(EVDS::Object*)), this, SLOT(childrenCreated(EVDS::Object*)));
 }
 
 
@@ -60,23 +71,24 @@ QVariant ObjectTreeModel::data(const QModelIndex &index, int role) const {
 	//Return icon
 	Object* object = (Object*)(index.internalPointer());
 	if ((role == Qt::DecorationRole) && (index.column() == 0)) {
-		QString type = object->getType();
+		Object::ObjectType type_id = object->getTypeId();
 
-		if (type == "fuel_tank") {
+		if (type_id == Object::TYPE_FUEL_TANK) {
 			if (object->isOxidizerTank()) {
 				return QIcon(":/icon/evds_type/fuel_tank_oxy.png");
 			} else {
 				return QIcon(":/icon/evds_type/fuel_tank_fuel.png");
 			}
-		} else if (type == "modifier") {
-			if (object->getString("pattern") == "copy") {
+		} else if (type_id == Object::TYPE_MODIFIER) {
+			if (object->getString(var_pattern) == "copy") {
 				return QIcon(":/icon/evds_type/modifier_copy.png");
-			} else if (object->getString("pattern") == "circular") {
+			} else if (object->getString(var_pattern) == "circular") {
 				return QIcon(":/icon/evds_type/modifier_circular.png");
 			} else {
 				return QIcon(":/icon/evds_type/modifier_linear.png");
 			}
 		} else {
+			QString type = object->getType();
 			if (QFile::exists(":/icon/evds_type/" + type + ".png")) {
 				return QIcon(":/icon/evds_type/" + type + ".png");
 			} else {
@@ -86,7 +98,7 @@ QVariant ObjectTreeModel::data(const QModelIndex &index, int role) const {
 	}
 
 	//Show item as disabled
-	if (object->getVariable("disable") > 0.5) {
+	if (object->getVariable(var_disable) > 0.5) {
 		if (role == Qt::ForegroundRole) {
 			return QColor(96,96,96);
 		}
@@ -136,68 +148,199 @@ QStringList ObjectTreeModel::mimeTypes() const {
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Clear editor objects stored in copied EVDS objects
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_ObjectMimeData_ClearUserdata(EVDS_OBJECT* object) {
+	EVDS_Object_SetUserdata(object,0);
+
+	SIMC_LIST* list;
+	EVDS_Object_GetAllChildren(object,&list);
+	SIMC_LIST_ENTRY* entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		FWE_ObjectMimeData_ClearUserdata((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		entry = SIMC_List_GetNext(list,entry);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get objects from the list, leaving out objects which are inside other listed objects
+////////////////////////////////////////////////////////////////////////////////
+static QList<Object*> FWE_ObjectTreeModel_GetTopObjects(const QModelIndexList &indexes) {
+	QSet<Object*> selected;
+	for (int i = 0; i < indexes.count(); i++) {
+		if (indexes[i].isValid() && (indexes[i].column() == 0)) {
+			selected.insert((Object*)(indexes[i].internalPointer()));
+		}
+	}
+
+	QList<Object*> objects;
+	for (int i = 0; i < indexes.count(); i++) {
+		if ((!indexes[i].isValid()) || (indexes[i].column() != 0)) continue;
+		Object* object = (Object*)(indexes[i].internalPointer());
+
+		Object* parent = object->getParent();
+		while (parent && (!selected.contains(parent))) parent = parent->getParent();
+		if (!parent && (!objects.contains(object))) objects.append(object);
+	}
+	return objects;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read the first object from XML description (it's created in inertial space)
+////////////////////////////////////////////////////////////////////////////////
+static EVDS_OBJECT* FWE_ObjectTreeModel_LoadObject(EVDS_SYSTEM* system, const QByteArray& description) {
+	EVDS_OBJECT_LOADEX info = { 0 };
+	info.flags = EVDS_OBJECT_LOADEX_SKIP_MODIFIERS | 
+				 EVDS_OBJECT_LOADEX_ONLY_FIRST;
+
+	info.description = (char*)malloc(description.size()+1);
+	memcpy(info.description,description.constData(),description.size());
+	info.description[description.size()] = 0;
+
+	EVDS_OBJECT* inertial_root;
+	EVDS_System_GetRootInertialSpace(system,&inertial_root);
+	EVDS_Object_LoadEx(inertial_root,0,&info);
+	free(info.description);
+	return info.firstObject;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy objects for dragging or clipboard. Copies are stored as children
+///  of a single list object.
+////////////////////////////////////////////////////////////////////////////////
+ObjectMimeData::ObjectMimeData(const QList<Object*>& objects, Object* in_root) {
+	root = in_root;
+	copies = 0;
+	if (objects.isEmpty()) return;
+
+	//Copy objects without going through XML
+	EVDS_SYSTEM* system;
+	EVDS_OBJECT* inertial_root;
+	EVDS_Object_GetSystem(root->getEVDSObject(),&system);
+	EVDS_System_GetRootInertialSpace(system,&inertial_root);
+	EVDS_Object_Create(inertial_root,&copies);
+	EVDS_Object_SetType(copies,FWE_OBJECT_LIST_TYPE);
+	for (int i = 0; i < objects.count(); i++) {
+		EVDS_OBJECT* copy;
+		EVDS_Object_Copy(objects[i]->getEVDSObject(),copies,&copy);
+	}
+	FWE_ObjectMimeData_ClearUserdata(copies);
+
+	//Encode reference for schematics editor (schematics objects are referenced by their data)
+	Object* object = objects[0];
+	EVDS_OBJECT* evds_object = object->getEVDSObject();
+	if (object->getType().mid(0,19) != "foxworks.schematics") {
+		EVDS_OBJECT_SAVEEX info = { 0 };
+		EVDS_OBJECT* reference;
+		EVDS_Object_Create(inertial_root,&reference);
+
+		//Get reference
+		char reference_str[8193] = { 0 };
+		EVDS_Object_GetReference(evds_object,root->getEVDSObject(),reference_str,8192);
+
+		//Write it
+		EVDS_VARIABLE* variable;
+		EVDS_Object_SetName(reference,object->getName().toAscii().data());
+		EVDS_Object_SetType(reference,"foxworks.schematics.element");
+		EVDS_Object_AddVariable(reference,"reference",EVDS_VARIABLE_TYPE_STRING,&variable);
+		EVDS_Variable_SetString(variable,reference_str,8193);
+
+		//Save it and encode
+		EVDS_Object_SaveEx(reference,0,&info);
+		encodedReferenceData = info.description;
+		free(info.description);
+
+		//Destroy temporary object
+		EVDS_Object_Destroy(reference);
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-QMimeData* ObjectTreeModel::mimeData(const QModelIndexList &indexes) const {
-	QMimeData *mimeData = new QMimeData();
-	QString encodedData = "";
-	QString encodedReferenceData = "";
-
-	//Store all EVDS objects (actually only a single selected one supported right now)
-	for (int i = 0; i < 1; i++) { //indexes.count()
-		QModelIndex index = indexes[i];
-		if (index.isValid() && (index.column() == 0)) {
-			EVDS_OBJECT_SAVEEX info = { 0 };
-			Object* object = (Object*)(index.internalPointer());
-
-			//Copy copies as normal objects if copy is selected
-			info.flags = EVDS_OBJECT_SAVEEX_SAVE_UIDS;
-			//if (object->isCopy()) info.flags |= EVDS_OBJECT_SAVEEX_SAVE_COPIES;// | EVDS_OBJECT_SAVEEX_SKIP_MODIFIERS;
-			EVDS_Object_SaveEx(object->getEVDSObject(),0,&info);
-
-			//Encode data
-			encodedData = info.description; //encodedData + info.description + "\n"
-			free(info.description);
-
-			//Encode reference for schematics editor
-			if (object->getType().mid(0,19) != "foxworks.schematics") {
-				EVDS_OBJECT* evds_object = object->getEVDSObject();
-				EVDS_OBJECT* reference;
-				EVDS_SYSTEM* system;
-				EVDS_OBJECT* inertial_root;
-				EVDS_Object_GetSystem(evds_object,&system);
-				EVDS_System_GetRootInertialSpace(system,&inertial_root);
-				EVDS_Object_Create(inertial_root,&reference);
-
-				//Get reference
-				char reference_str[8193] = { 0 };
-				EVDS_Object_GetReference(evds_object,window->getEditRoot()->getEVDSObject(),reference_str,8192);
-
-				//Write it
-				EVDS_VARIABLE* variable;
-				EVDS_Object_SetName(reference,object->getName().toAscii().data());
-				EVDS_Object_SetType(reference,"foxworks.schematics.element");
-				EVDS_Object_AddVariable(reference,"reference",EVDS_VARIABLE_TYPE_STRING,&variable);
-				EVDS_Variable_SetString(variable,reference_str,8193);
-				
-				//Save it and encode
-				EVDS_Object_SaveEx(reference,0,&info);
-				encodedReferenceData = info.description;
-				free(info.description);
-
-				//Destroy temporary object
-				EVDS_Object_Destroy(reference);
-			} else {
-				encodedReferenceData = encodedData;
-			}
+ObjectMimeData::~ObjectMimeData() {
+	if (copies && root) EVDS_Object_Destroy(copies);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QStringList ObjectMimeData::formats() const {
+	QStringList types;
+	types << "application/vnd.evds+xml";
+	types << "application/vnd.evds.ref+xml";
+	types << "text/plain";
+	return types;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+EVDS_OBJECT* ObjectMimeData::getCopies() const {
+	if (!root) return 0;
+	return copies;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Encode objects into XML (only done once)
+////////////////////////////////////////////////////////////////////////////////
+void ObjectMimeData::encode() const {
+	if ((!encodedData.isEmpty()) || (!getCopies())) return;
+
+	//Single object is written on its own, several objects inside of the list object
+	SIMC_LIST* list;
+	EVDS_Object_GetAllChildren(copies,&list);
+	EVDS_OBJECT* object = copies;
+	SIMC_LIST_ENTRY* entry = SIMC_List_GetFirst(list);
+	if (entry) {
+		EVDS_OBJECT* first = (EVDS_OBJECT*)SIMC_List_GetData(list,entry);
+		entry = SIMC_List_GetNext(list,entry);
+		if (!entry) {
+			object = first;
+		} else {
+			SIMC_List_Stop(list,entry);
 		}
 	}
 
-	mimeData->setText(encodedData);
-	mimeData->setData("application/vnd.evds+xml",encodedData.toUtf8());
-	mimeData->setData("application/vnd.evds.ref+xml",encodedReferenceData.toUtf8());
-	return mimeData;
+	EVDS_OBJECT_SAVEEX info = { 0 };
+	info.flags = EVDS_OBJECT_SAVEEX_SAVE_UIDS;
+	EVDS_Object_SaveEx(object,0,&info);
+	encodedData = info.description;
+	free(info.description);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Encode object into XML when it's first requested
+////////////////////////////////////////////////////////////////////////////////
+QVariant ObjectMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const {
+	if ((mimeType == "application/vnd.evds.ref+xml") && (!encodedReferenceData.isEmpty())) {
+		return encodedReferenceData;
+	}
+	if (!formats().contains(mimeType)) return QVariant();
+
+	encode();
+	if (mimeType == "text/plain") return QString::fromUtf8(encodedData);
+	return encodedData;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QMimeData* ObjectTreeModel::mimeData(const QModelIndexList &indexes) const {
+	//Store all EVDS objects
+	QList<Object*> objects = FWE_ObjectTreeModel_GetTopObjects(indexes);
+	if (objects.isEmpty()) return new QMimeData();
+	return new ObjectMimeData(objects,window->getEditRoot());
 }
 
 
@@ -211,31 +354,86 @@ bool ObjectTreeModel::dropMimeData(const QMimeData *data, Qt::DropAction action,
 	if (!data->hasFormat(acceptedMimeType)) return false;
 	if (column > 0) return false;
 
+	//Insert new objects from encoded data
+	Object* object;
+	if (!parent.isValid()) {
+		object = root;
+	} else {
+		object = (Object*)(parent.internalPointer());
+	}
+
+	//Children must exist before anything is inserted between them
+	if (object->isCollapsed()) window->createChildren(object);
+
 	//Get index
 	int beginRow;
 	if (row != -1) {
 		beginRow = row;
-	} else if (parent.isValid()) {
-		beginRow = parent.row(); // rowCount(parent);//
 	} else {
-		beginRow = rowCount(QModelIndex());
+		beginRow = rowCount(parent);
 	}
 
-	//Insert new object from encoded data
-	Object* object;
-	if (!parent.isValid()) {
-		object = root;
-	} else {
-		object = (Object*)(parent.internalPointer());
+	//Copy objects directly when they come from the same document
+	EVDS_SYSTEM* system;
+	EVDS_Object_GetSystem(object->getEVDSObject(),&system);
+	EVDS_OBJECT* copies = 0;
+	const ObjectMimeData* objectData = qobject_cast<const ObjectMimeData*>(data);
+	if (objectData && (acceptedMimeType == "application/vnd.evds+xml")) {
+		copies = objectData->getCopies();
+
+		EVDS_SYSTEM* copies_system = 0;
+		if (copies) EVDS_Object_GetSystem(copies,&copies_system);
+		if (copies_system != system) copies = 0;
+	}
+
+	//Otherwise read objects from XML (data is empty if source document was closed)
+	EVDS_OBJECT* loaded = 0;
+	QList<EVDS_OBJECT*> sources;
+	if (!copies) {
+		QByteArray description = data->data(acceptedMimeType);
+		if (description.isEmpty()) return false;
+		loaded = FWE_ObjectTreeModel_LoadObject(system,description);
+		if (!loaded) return false;
+
+		char type[257] = { 0 };
+		EVDS_Object_GetType(loaded,type,256);
+		if (strcmp(type,FWE_OBJECT_LIST_TYPE) == 0) {
+			copies = loaded;
+		} else {
+			sources.append(loaded);
+		}
 	}
 
+	//List all objects to insert
+	if (copies) {
+		SIMC_LIST* list;
+		EVDS_Object_GetAllChildren(copies,&list);
+		SIMC_LIST_ENTRY* entry = SIMC_List_GetFirst(list);
+		while (entry) {
+			sources.append((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+			entry = SIMC_List_GetNext(list,entry);
+		}
+	}
+	if (sources.isEmpty()) {
+		if (loaded) EVDS_Object_Destroy(loaded);
+		return false;
+	}
+
+	//Insert all objects, modifiers and views are updated once at the end
 	QApplication::setOverrideCursor(Qt::WaitCursor);
-	beginInsertRows(parent,beginRow,beginRow);
-		object->insertChild(beginRow,QString(data->data(acceptedMimeType)));
+	window->beginBatchUpdate();
+	QList<Object*> inserted;
+	beginInsertRows(parent,beginRow,beginRow+sources.count()-1);
+		for (int i = 0; i < sources.count(); i++) {
+			inserted.append(object->insertCopy(beginRow+i,sources[i]));
+		}
 	endInsertRows();
+	for (int i = 0; i < inserted.count(); i++) {
+		window->objectInserted(inserted[i]);
+	}
+	if (loaded) EVDS_Object_Destroy(loaded);
+	window->endBatchUpdate();
 	QApplication::restoreOverrideCursor();
-
-	window->setModified();
 	return true;
 }
 
@@ -313,6 +511,59 @@ int ObjectTreeModel::rowCount(const QModelIndex &parent) const {
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collapsed objects have children which are created when fetched
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectTreeModel::hasChildren(const QModelIndex &parent) const {
+	if (parent.column() > 0) return false;
+	if (!parent.isValid()) return root->getChildrenCount() > 0;
+
+	Object* object = (Object*)(parent.internalPointer());
+	return object->isCollapsed() || (object->getChildrenCount() > 0);
+}
+
+bool ObjectTreeModel::canFetchMore(const QModelIndex &parent) const {
+	if (!parent.isValid()) return false;
+	Object* object = (Object*)(parent.internalPointer());
+	return object->isCollapsed();
+}
+
+void ObjectTreeModel::fetchMore(const QModelIndex &parent) {
+	if (!parent.isValid()) return;
+	Object* object = (Object*)(parent.internalPointer());
+	window->createChildren(object);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectTreeModel::getObjectIndex(Object* object, QModelIndex* index) {
+	if (object == root) {
+		*index = QModelIndex();
+		return true;
+	}
+
+	//Object must be somewhere under the root of this model
+	Object* parent = object->getParent();
+	while (parent && (parent != root)) parent = parent->getParent();
+	if (!parent) return false;
+
+	*index = createIndex(object->getParent()->getChildIndex(object),0,object);
+	return true;
+}
+
+void ObjectTreeModel::childrenAboutToBeCreated(EVDS::Object* object, int count) {
+	QModelIndex index;
+	if ((count > 0) && getObjectIndex(object,&index)) beginInsertRows(index,0,count-1);
+}
+
+void ObjectTreeModel::childrenCreated(EVDS::Object* object) {
+	QModelIndex index;
+	if ((object->getChildrenCount() > 0) && getObjectIndex(object,&index)) endInsertRows();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -324,12 +575,13 @@ bool ObjectTreeModel::insertRows(int row, int count, const QModelIndex &parent)
 		object = (Object*)(parent.internalPointer());
 	}
 
+	window->beginBatchUpdate();
 	beginInsertRows(parent,row,row+count-1);
 		for (int r=row;r<row+count;r++) {
-			object->insertNewChild(r);
+			window->objectInserted(object->insertNewChild(r));
 		}
 	endInsertRows();
-	window->setModified();
+	window->endBatchUpdate();
 	return true;
 }
 
@@ -345,16 +597,38 @@ bool ObjectTreeModel::removeRows(int row, int count, const QModelIndex &parent)
 		object = (Object*)(parent.internalPointer());
 	}
 
+	//Rows shift as objects are removed, so the same row is removed every time
+	window->beginBatchUpdate();
 	beginRemoveRows(parent,row,row+count-1);
 		for (int r=row;r<row+count;r++) {
-			object->removeChild(r);
+			if (row < object->getChildrenCount()) window->objectRemoved(object->getChild(row));
+			object->removeChild(row);
 		}
 	endRemoveRows();
-	window->setModified();
+	window->endBatchUpdate();
 	return true;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Remove several objects, modifiers and views are updated once at the end
+////////////////////////////////////////////////////////////////////////////////
+void ObjectTreeModel::removeObjects(const QModelIndexList &indexes) {
+	QList<Object*> objects = FWE_ObjectTreeModel_GetTopObjects(indexes);
+	if (objects.isEmpty()) return;
+
+	QApplication::setOverrideCursor(Qt::WaitCursor);
+	window->beginBatchUpdate();
+	for (int i = 0; i < objects.count(); i++) {
+		QModelIndex parent;
+		if (!getObjectIndex(objects[i]->getParent(),&parent)) continue;
+		removeRows(objects[i]->getParent()->getChildIndex(objects[i]),1,parent);
+	}
+	window->endBatchUpdate();
+	QApplication::restoreOverrideCursor();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -383,6 +657,15 @@ void ObjectTreeModel::updateObject(Object* object) {
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectTreeModel::reloadObjects() {
+	beginResetModel();
+	endResetModel();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -397,6 +680,6 @@ Object* ObjectTreeModel::newObject(int row, QModelIndex index) {
 	beginInsertRows(index,row,row);
 		object = object->insertNewChild(row);
 	endInsertRows();
-	window->setModified();
+	window->objectInserted(object);
 	return object;
 }
\ No newline at end of file
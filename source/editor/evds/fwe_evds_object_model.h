@@ -22,6 +22,10 @@
 #include <QAbstractItemModel>
 #include <QModelIndex>
 #include <QVariant>
+#include <QMimeData>
+#include <QPointer>
+
+#include "evds.h"
 
 namespace FWE {
 	class EditorWindow;
@@ -29,6 +33,36 @@ namespace FWE {
 namespace EVDS {
 	class Editor;
 	class Object;
+
+	//Dragged or copied objects. Holds copies of the EVDS objects, which are inserted directly
+	// when dropped into the same document. XML of dragged objects is only written when another
+	// application asks for it, copied objects are encoded right away (see encode()).
+	class ObjectMimeData : public QMimeData
+	{
+		Q_OBJECT
+
+	public:
+		ObjectMimeData(const QList<Object*>& objects, Object* in_root);
+		~ObjectMimeData();
+
+		QStringList formats() const;
+		//Get object which holds copies as its children (0 if document they were taken from no longer exists)
+		EVDS_OBJECT* getCopies() const;
+		//Encode objects into XML now, so data stays available after the document is closed
+		void encode() const;
+
+	protected:
+		QVariant retrieveData(const QString& mimeType, QVariant::Type type) const;
+
+	private:
+		QPointer<Object> root;
+		EVDS_OBJECT* copies;
+
+		//Data encoded on request
+		mutable QByteArray encodedData;
+		QByteArray encodedReferenceData;
+	};
+
 	class ObjectTreeModel : public QAbstractItemModel
 	{
 		Q_OBJECT
@@ -46,13 +80,20 @@ namespace EVDS {
 		QModelIndex parent(const QModelIndex &index) const;
 		int rowCount(const QModelIndex &parent = QModelIndex()) const;
 		int columnCount(const QModelIndex &parent = QModelIndex()) const;
+		bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+		bool canFetchMore(const QModelIndex &parent) const;
+		void fetchMore(const QModelIndex &parent);
 		bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex());
 		bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
 		bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
 
 		Object* newObject(int row, QModelIndex index);
+		//Remove all listed objects (objects inside of other listed objects are removed with them)
+		void removeObjects(const QModelIndexList &indexes);
 
 		void updateObject(Object* object);
+		//Objects hierarchy was replaced entirely (after loading a file)
+		void reloadObjects();
 		void setAcceptedMimeType(const QString& type) { acceptedMimeType = type; }
 
 		Qt::DropActions supportedDropActions() const { return Qt::CopyAction | Qt::MoveAction; }
@@ -60,7 +101,14 @@ namespace EVDS {
 		QMimeData* mimeData(const QModelIndexList &indexes) const;
 		bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent);
 
+	private slots:
+		//Children of a collapsed object are created
+		void childrenAboutToBeCreated(EVDS::Object* object, int count);
+		void childrenCreated(EVDS::Object* object);
+
 	private:
+		//Get index of object, returns false if object is not listed in this model
+		bool getObjectIndex(Object* object, QModelIndex* index);
 		QString acceptedMimeType;
 		FWE::EditorWindow* window;
 		EVDS::Object* root;
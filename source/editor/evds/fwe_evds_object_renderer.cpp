@@ -21,16 +21,32 @@
 #include "fwe_evds.h"
 #include "fwe_evds_object.h"
 #include "fwe_evds_object_renderer.h"
+#include "fwe_evds_residency.h"
 #include "fwe_glscene.h"
+#include "fwe_trace.h"
 
 using namespace EVDS;
 
+//Delay between request for a new mesh and start of the job (repeated requests restart it)
+#define FWE_LOD_UPDATE_DELAY		500
+//Interval at which the scheduler checks for requests whose delay is over
+#define FWE_LOD_UPDATE_INTERVAL		50
+//Number of slots allocated at once by renderer pools
+#define FWE_RENDERER_POOL_BLOCK		64
+//Slot header (pointer to the pool), keeps alignment of the stored object
+#define FWE_RENDERER_POOL_HEADER	16
+
+//Interned variable names
+static const VariableRef var_disable("disable");
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 ObjectRenderer::ObjectRenderer(Object* in_object) {
 	object = in_object;
+	firstResidentLod = 0;
+	cachedBytes = 0;
 
 	//Create meshes
 	glcMesh = new GLC_Mesh();
@@ -42,12 +58,25 @@ ObjectRenderer::ObjectRenderer(Object* in_object) {
 	if (lod_count < 1) lod_count = 1;
 	if (lod_count > 20) lod_count = 20;
 
-	//Create mesh generators
-	lodMeshGenerator = new ObjectLODGenerator(object,lod_count);
-	connect(lodMeshGenerator, SIGNAL(signalLODsReady()), this, SLOT(lodMeshesGenerated()), Qt::QueuedConnection);
-	if (fw_editor_settings->value("rendering.no_lods") == false) {
-		lodMeshGenerator->start();
-	}
+	//Create mesh generator (jobs are run by the worker threads of the document)
+	ObjectLODScheduler* scheduler = object->getEVDSEditor()->getLODScheduler();
+	lodMeshGenerator = new (scheduler->getGeneratorPool()) ObjectLODGenerator(this,object,lod_count,scheduler);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void* ObjectRenderer::operator new(size_t size, ObjectRendererPool* pool) {
+	return ObjectRendererPool::allocate(pool,size);
+}
+
+void ObjectRenderer::operator delete(void* ptr, ObjectRendererPool* pool) {
+	ObjectRendererPool::release(ptr);
+}
+
+void ObjectRenderer::operator delete(void* ptr) {
+	ObjectRendererPool::release(ptr);
 }
 
 
@@ -60,6 +89,7 @@ ObjectRenderer::~ObjectRenderer() {
 
 	//Remove instances from glview
 	if (object->getEVDSEditor()) {
+		object->getEVDSEditor()->getResidencyManager()->meshRemoved(this);
 		GLScene* glview = object->getEVDSEditor()->getGLScene();
 		if (glview->getCollection()->contains(glcInstance->id())) {
 			glview->getCollection()->remove(glcInstance->id());
@@ -69,8 +99,14 @@ ObjectRenderer::~ObjectRenderer() {
 	delete glcInstance;
 	delete glcMeshRep;
 	delete glcMesh;
-	lodMeshGenerator->stopWork();
-	lodMeshGenerator->deleteLater();
+
+	//Generator may still be used by a worker thread, scheduler deletes it once it's done
+	if (lodMeshGenerator->getScheduler()) {
+		lodMeshGenerator->getScheduler()->removeGenerator(lodMeshGenerator);
+	} else {
+		lodMeshGenerator->stopWork();
+		delete lodMeshGenerator;
+	}
 }
 
 
@@ -79,6 +115,7 @@ ObjectRenderer::~ObjectRenderer() {
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectRenderer::positionChanged() {
 	if (!object->getEVDSEditor()->getActive()) return;
+	FWE_TRACE("ObjectRenderer::positionChanged");
 	qDebug("ObjectRenderer::positionChanged()");
 
 	GLScene* glview = object->getEVDSEditor()->getGLScene();
@@ -101,7 +138,7 @@ void ObjectRenderer::positionChanged() {
 		glcInstance->translate(vector.position.x,vector.position.y,vector.position.z);
 
 		//Update visibility of this object
-		if (object->getVariable("disable") > 0.5) {
+		if (object->getVariable(var_disable) > 0.5) {
 			glcInstance->setVisibility(false);
 		} else {
 			glcInstance->setVisibility(true);
@@ -136,7 +173,11 @@ void ObjectRenderer::positionChanged() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectRenderer::meshChanged() {
-	if (object->getType() != "modifier") {
+	//Meshes are generated later while objects of a loaded file are being created
+	if (object->getEVDSEditor()->getResidencyManager()->queueMesh(this)) return;
+	FWE_TRACE("ObjectRenderer::meshChanged");
+
+	if (object->getTypeId() != Object::TYPE_MODIFIER) {
 		EVDS_MESH* mesh;
 
 		//Create temporary object
@@ -189,27 +230,109 @@ void ObjectRenderer::meshChanged() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectRenderer::lodMeshesGenerated() {
+	FWE_TRACE("ObjectRenderer::lodMeshesGenerated");
 	//qDebug("ObjectRenderer: LOD ready %p",this);
 	
 	lodMeshGenerator->readingLock.lock();
+		ObjectLODGeneratorResult* result = lodMeshGenerator->getResult();
+
+		//Remember size of every LOD, keep evicted LODs evicted
+		lodBytes.clear();
+		lodTriangles.clear();
+		for (int lod = 0; lod < lodMeshGenerator->getNumLODs(); lod++) {
+			lodBytes.append(result->getLODBytes(lod));
+			lodTriangles.append(result->getLODTriangles(lod));
+		}
+		cachedBytes = result->getBytes();
+		if (firstResidentLod >= lodMeshGenerator->getNumLODs()) firstResidentLod = lodMeshGenerator->getNumLODs()-1;
+
 		glcMesh->clear();
-		lodMeshGenerator->getResult()->setGLCMesh(glcMesh,object);
+		result->setGLCMesh(glcMesh,object,firstResidentLod);
 		glcMesh->finish();
 
 		glcInstance->setMatrix(glcInstance->matrix()); //This causes bounding box to be updated
 		object->getEditorWindow()->updateObject(NULL); //Force into repaint
+		lodMeshGenerator->finishJob();
 	lodMeshGenerator->readingLock.unlock();
 
+	if (object->getEVDSEditor()) {
+		object->getEVDSEditor()->getResidencyManager()->meshLoaded(this);
+	}
+
 	object->getEditorWindow()->getMainWindow()->statusBar()->showMessage("Generating LODs...",1000);
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+int ObjectRenderer::getNumLODs() {
+	return lodMeshGenerator->getNumLODs();
+}
+
+qint64 ObjectRenderer::getResidentBytes() {
+	qint64 bytes = 0;
+	for (int lod = firstResidentLod; lod < lodBytes.count(); lod++) {
+		bytes += lodBytes[lod];
+	}
+	return bytes;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Rebuild mesh without LODs finer than the given one.
+///
+/// Mesh is rebuilt from the copy kept by the LOD generator. If that copy was
+/// dropped, a new mesh is generated instead.
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectRenderer::setFirstResidentLOD(int lod) {
+	if ((lod < 0) || (lod >= getNumLODs())) return false;
+	if (lodMeshGenerator->isJobPending()) return false; //New mesh will arrive soon
+	if (!lodMeshGenerator->readingLock.tryLock()) return false;
+
+		ObjectLODGeneratorResult* result = lodMeshGenerator->getResult();
+		bool fromCache = !result->isEmpty();
+		firstResidentLod = lod;
+		if (fromCache) {
+			glcMesh->clear();
+			result->setGLCMesh(glcMesh,object,firstResidentLod);
+			glcMesh->finish();
+			glcInstance->setMatrix(glcInstance->matrix()); //This causes bounding box to be updated
+		}
+	lodMeshGenerator->readingLock.unlock();
+
+	//Generate mesh again (current LODs remain until it's ready)
+	if (!fromCache) lodMeshGenerator->updateMesh();
+	if (object->getEVDSEditor()) {
+		object->getEVDSEditor()->getResidencyManager()->meshReloaded(this,fromCache);
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectRenderer::dropCachedMesh() {
+	if (lodMeshGenerator->isJobPending()) return false;
+	if (!lodMeshGenerator->readingLock.tryLock()) return false;
+		lodMeshGenerator->getResult()->clear();
+		cachedBytes = 0;
+	lodMeshGenerator->readingLock.unlock();
+	return true;
+}
+
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectLODGeneratorResult::appendMesh(EVDS_MESH* mesh, int lod) {
+	//Remember where vertices of this LOD start
+	while (lodVertexOffsets.count() <= lod) {
+		lodVertexOffsets.append(verticesVector.count()/3);
+	}
 	if (!mesh) return;
 
 	//Add empty mesh?
@@ -255,16 +378,23 @@ void ObjectLODGeneratorResult::appendMesh(EVDS_MESH* mesh, int lod) {
 	}
 }
 
-void ObjectLODGeneratorResult::setGLCMesh(GLC_Mesh* glcMesh, Object* object) {
+void ObjectLODGeneratorResult::setGLCMesh(GLC_Mesh* glcMesh, Object* object, int firstLod) {
 	//QApplication::setOverrideCursor(Qt::WaitCursor);
-	glcMesh->addVertice(verticesVector);
-	glcMesh->addNormals(normalsVector);
+	int firstVertex = lodVertexOffsets.value(firstLod,0);
+	if (firstVertex > 0) {
+		glcMesh->addVertice(verticesVector.mid(firstVertex*3));
+		glcMesh->addNormals(normalsVector.mid(firstVertex*3));
+	} else {
+		glcMesh->addVertice(verticesVector);
+		glcMesh->addNormals(normalsVector);
+	}
 	for (int i = 0; i < indicesLists.count(); i++) {
+		if (lodList[i] < firstLod) continue; //LOD is not resident
 		if (!indicesLists[i].isEmpty()) {
 			GLC_Material* glcMaterial = new GLC_Material();
 			
 			//Special color logic
-			if (object->getType() == "fuel_tank") {
+			if (object->getTypeId() == Object::TYPE_FUEL_TANK) {
 				if (object->isOxidizerTank()) {
 					glcMaterial->setDiffuseColor(QColor(0,0,255));
 				} else {
@@ -272,18 +402,55 @@ void ObjectLODGeneratorResult::setGLCMesh(GLC_Mesh* glcMesh, Object* object) {
 				}
 			}
 
-			//Add smoothing group
-			glcMesh->addTriangles(glcMaterial, indicesLists[i], lodList[i]);
+			//Add smoothing group (renumbered if finest LODs are not resident)
+			if (firstVertex > 0) {
+				IndexList indices = indicesLists[i];
+				for (int j = 0; j < indices.count(); j++) indices[j] -= firstVertex;
+				glcMesh->addTriangles(glcMaterial, indices, lodList[i]-firstLod);
+			} else {
+				glcMesh->addTriangles(glcMaterial, indicesLists[i], lodList[i]);
+			}
 		}
 	}
 	//QApplication::restoreOverrideCursor();
 }
 
+qint64 ObjectLODGeneratorResult::getLODBytes(int lod) {
+	if (lod >= lodVertexOffsets.count()) return 0;
+	int firstVertex = lodVertexOffsets[lod];
+	int lastVertex = verticesVector.count()/3;
+	if (lod+1 < lodVertexOffsets.count()) lastVertex = lodVertexOffsets[lod+1];
+
+	//Vertices and normals, indices
+	qint64 bytes = ((qint64)(lastVertex-firstVertex))*6*sizeof(GLfloat);
+	for (int i = 0; i < indicesLists.count(); i++) {
+		if (lodList[i] == lod) bytes += indicesLists[i].count()*sizeof(GLuint);
+	}
+	return bytes;
+}
+
+int ObjectLODGeneratorResult::getLODTriangles(int lod) {
+	int triangles = 0;
+	for (int i = 0; i < indicesLists.count(); i++) {
+		if (lodList[i] == lod) triangles += indicesLists[i].count()/3;
+	}
+	return triangles;
+}
+
+qint64 ObjectLODGeneratorResult::getBytes() {
+	qint64 bytes = 0;
+	for (int lod = 0; lod < lodVertexOffsets.count(); lod++) {
+		bytes += getLODBytes(lod);
+	}
+	return bytes;
+}
+
 void ObjectLODGeneratorResult::clear() {
 	verticesVector.clear();
 	normalsVector.clear();
 	indicesLists.clear();
 	lodList.clear();
+	lodVertexOffsets.clear();
 }
 
 
@@ -305,19 +472,43 @@ float ObjectLODGenerator::getLODResolution(int lod) {
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-ObjectLODGenerator::ObjectLODGenerator(Object* in_object, int in_lods) {
+ObjectLODGenerator::ObjectLODGenerator(ObjectRenderer* in_renderer, Object* in_object, int in_lods,
+									   ObjectLODScheduler* in_scheduler) {
+	renderer = in_renderer;
 	object = in_object;
 	numLods = in_lods;
-	editor = object->getEVDSEditor();
-
-	//Initialize temporary object
+	scheduler = in_scheduler;
 	object_copy = 0;
 
-	//Delete thread when work is finished
-	connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
-	connect(&updateCallTimer, SIGNAL(timeout()), this, SLOT(doUpdateMesh()));
-	doStopWork = false;
-	needMesh = false; 
+	doStopWork = 0;
+	meshGeneration = 0;
+	needMesh = 0;
+	jobPending = false;
+	if (scheduler) scheduler->generators.insert(this);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+ObjectLODGenerator::~ObjectLODGenerator() {
+	if (object_copy) EVDS_Object_Destroy(object_copy);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void* ObjectLODGenerator::operator new(size_t size, ObjectRendererPool* pool) {
+	return ObjectRendererPool::allocate(pool,size);
+}
+
+void ObjectLODGenerator::operator delete(void* ptr, ObjectRendererPool* pool) {
+	ObjectRendererPool::release(ptr);
+}
+
+void ObjectLODGenerator::operator delete(void* ptr) {
+	ObjectRendererPool::release(ptr);
 }
 
 
@@ -333,90 +524,393 @@ ObjectLODGeneratorResult* ObjectLODGenerator::getResult() {
 /// @brief Get a temporary copy of the rendered object
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectLODGenerator::doUpdateMesh() {
-	updateCallTimer.stop();
+	FWE_TRACE("ObjectLODGenerator::copyObject");
+	if (!scheduler) return;
+
+	//Running job is aborted at the next check, lock is never held while it generates
+	meshGeneration.ref();
 	readingLock.lock();
-		needMesh = true;
-		if (this->isRunning()) {
-			EVDS_OBJECT* inertial_root;
-			EVDS_SYSTEM* system;
-			EVDS_Object_GetSystem(object->getEVDSObject(),&system);
-			EVDS_System_GetRootInertialSpace(system,&inertial_root);
-			EVDS_Object_CopySingle(object->getEVDSObject(),inertial_root,&object_copy);
-		}
+		needMesh.fetchAndStoreOrdered(1);
+		if (object_copy) EVDS_Object_Destroy(object_copy); //Previous copy was never used
+
+		EVDS_OBJECT* inertial_root;
+		EVDS_SYSTEM* system;
+		EVDS_Object_GetSystem(object->getEVDSObject(),&system);
+		EVDS_System_GetRootInertialSpace(system,&inertial_root);
+		EVDS_Object_CopySingle(object->getEVDSObject(),inertial_root,&object_copy);
 	readingLock.unlock();
+
+	scheduler->queueJob(this);
 }
 
 void ObjectLODGenerator::updateMesh() {
+	if ((!scheduler) || (!scheduler->isEnabled())) return;
+
 	//qDebug("ObjectLODGenerator::updateMesh: start timer");
-	updateCallTimer.start(500);
+	if (!jobPending) {
+		jobPending = true;
+		pendingJobs.ref();
+	}
+	scheduler->scheduleUpdate(this);
 }
 
 void ObjectLODGenerator::stopWork() {
-	doStopWork = true;
+	doStopWork.fetchAndStoreOrdered(1);
+	meshGeneration.ref();
+	if (jobPending) {
+		jobPending = false;
+		pendingJobs.deref();
+	}
+}
+
+void ObjectLODGenerator::finishJob() {
+	//Another mesh was requested while this one was being generated
+	if (isMeshNeeded() || (scheduler && scheduler->isUpdateScheduled(this))) return;
+	if (jobPending) {
+		jobPending = false;
+		pendingJobs.deref();
+	}
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void ObjectLODGenerator::run() {
-	editor->getEditorWindow()->threadStarted();
+bool ObjectLODGenerator::generate() {
+	//Take the copy of the object, the lock is released while meshes are generated
+	readingLock.lock();
+		if ((!isMeshNeeded()) || (doStopWork != 0)) {
+			readingLock.unlock();
+			return false;
+		}
+		needMesh.fetchAndStoreOrdered(0);
+		int generation = meshGeneration;
+		EVDS_OBJECT* work_object = object_copy; //Fetch the pointer
+		object_copy = 0;
+	readingLock.unlock();
 
-	//msleep(1000 + (qrand() % 5000)); //Give enough time for the rest of application to initialize
-	while (!doStopWork) {
-		readingLock.lock();
-		if (needMesh) {
-			//Start making the mesh
-			needMesh = false;
-			ObjectLODGenerator::threadsSemaphore.acquire();
-
-			//Transfer and initialize work object
-			EVDS_OBJECT* work_object = object_copy; //Fetch the pointer
-			EVDS_Object_TransferInitialization(work_object); //Get rights to work with variables
-			EVDS_Object_Initialize(work_object,1);
-			object_copy = 0;
-
-			result.clear();
-			for (int lod = 0; lod < numLods; lod++) {
-				//Check if job must be aborted
-				if (needMesh || doStopWork) {
-					qDebug("ObjectLODGenerator: aborted job early");
-					break;
-				}
+	bool ready = false;
+	{
+		FWE_TRACE("ObjectLODGenerator::job");
 
-				//Create new one
-				EVDS_MESH* mesh;
-				EVDS_MESH_GENERATEEX info = { 0 };
-				info.resolution = getLODResolution(numLods-lod-1);
-				info.min_resolution = fw_editor_settings->value("rendering.min_resolution").toFloat();
-				info.flags = EVDS_MESH_USE_DIVISIONS;
+		//Start making the mesh
+		ObjectLODGenerator::threadsSemaphore.acquire();
+
+		//Transfer and initialize work object
+		EVDS_Object_TransferInitialization(work_object); //Get rights to work with variables
+		EVDS_Object_Initialize(work_object,1);
+
+		ObjectLODGeneratorResult job_result;
+		bool cancelled = false;
+		for (int lod = 0; lod < numLods; lod++) {
+			//Check if job must be aborted
+			if (isJobCancelled(generation)) {
+				cancelled = true;
+				break;
+			}
+
+			//Create new one
+			EVDS_MESH* mesh;
+			EVDS_MESH_GENERATEEX info = { 0 };
+			info.resolution = getLODResolution(numLods-lod-1);
+			info.min_resolution = fw_editor_settings->value("rendering.min_resolution").toFloat();
+			info.flags = EVDS_MESH_USE_DIVISIONS;
 
-				EVDS_Mesh_GenerateEx(work_object,&mesh,&info);
-				result.appendMesh(mesh,lod);
+			FWE_TRACE("ObjectLODGenerator::generateLOD");
+			EVDS_Mesh_GenerateEx(work_object,&mesh,&info);
+
+			//Do not convert a mesh which is no longer needed
+			if (isJobCancelled(generation)) {
 				EVDS_Mesh_Destroy(mesh);
-				//printf("Done mesh %p %p for level %d\n",object,mesh,lod);
+				cancelled = true;
+				break;
 			}
+			job_result.appendMesh(mesh,lod);
+			EVDS_Mesh_Destroy(mesh);
+			//printf("Done mesh %p %p for level %d\n",object,mesh,lod);
+		}
 
-			//Make sure not too many threads run expensive tasks at once
-			ObjectLODGenerator::threadsSemaphore.release();
+		//Make sure not too many threads run expensive tasks at once
+		ObjectLODGenerator::threadsSemaphore.release();
+
+		//Release the object that was worked on
+		if (work_object) {
+			EVDS_Object_Destroy(work_object);
+		}
 
-			//Release the object that was worked on
-			if (work_object) {
-				EVDS_Object_Destroy(work_object);
+		//If new mesh is needed, do not return generated one - return actually needed one instead
+		readingLock.lock();
+			if ((!cancelled) && (!isJobCancelled(generation))) {
+				result = job_result;
+				ready = true;
+			} else {
+				qDebug("ObjectLODGenerator: aborted job early");
+				abortedJobs.ref();
 			}
+		readingLock.unlock();
+	}
+	return ready;
+}
+
+QSemaphore ObjectLODGenerator::threadsSemaphore(QThread::idealThreadCount());
+QAtomicInt ObjectLODGenerator::pendingJobs(0);
+QAtomicInt ObjectLODGenerator::abortedJobs(0);
 
-			//If new mesh is needed, do not return generated one - return actually needed one instead
-			if (!needMesh) {
-				emit signalLODsReady();
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+ObjectRendererPool::ObjectRendererPool(size_t in_slotSize) {
+	//Round slot up to the header size to keep every slot aligned
+	slotSize = FWE_RENDERER_POOL_HEADER + in_slotSize;
+	slotSize = ((slotSize + FWE_RENDERER_POOL_HEADER - 1) / FWE_RENDERER_POOL_HEADER) * FWE_RENDERER_POOL_HEADER;
+	usedSlots = 0;
+	detached = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+ObjectRendererPool::~ObjectRendererPool() {
+	for (int i = 0; i < blocks.count(); i++) {
+		delete[] blocks[i];
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Every slot starts with a pointer to its pool, so it can be released
+///  without knowing the document it belongs to.
+////////////////////////////////////////////////////////////////////////////////
+void* ObjectRendererPool::allocate(ObjectRendererPool* pool, size_t size) {
+	char* slot;
+	if (!pool) {
+		slot = new char[FWE_RENDERER_POOL_HEADER + size];
+	} else {
+		Q_ASSERT(FWE_RENDERER_POOL_HEADER + size <= pool->slotSize);
+		pool->lock.lock();
+			if (pool->freeSlots.isEmpty()) {
+				char* block = new char[pool->slotSize*FWE_RENDERER_POOL_BLOCK];
+				pool->blocks.append(block);
+				for (int i = FWE_RENDERER_POOL_BLOCK-1; i >= 0; i--) {
+					pool->freeSlots.append(block + i*pool->slotSize);
+				}
 			}
+			slot = pool->freeSlots.takeLast();
+			pool->usedSlots++;
+		pool->lock.unlock();
+	}
+	*((ObjectRendererPool**)slot) = pool;
+	return slot + FWE_RENDERER_POOL_HEADER;
+}
+
+void ObjectRendererPool::release(void* ptr) {
+	if (!ptr) return;
+	char* slot = (char*)ptr - FWE_RENDERER_POOL_HEADER;
+	ObjectRendererPool* pool = *((ObjectRendererPool**)slot);
+	if (pool) {
+		pool->releaseSlot(slot);
+	} else {
+		delete[] slot;
+	}
+}
+
+void ObjectRendererPool::releaseSlot(char* slot) {
+	bool unused;
+	lock.lock();
+		freeSlots.append(slot);
+		usedSlots--;
+		unused = detached && (usedSlots == 0);
+	lock.unlock();
+	if (unused) delete this;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectRendererPool::detach() {
+	bool unused;
+	lock.lock();
+		detached = true;
+		unused = (usedSlots == 0);
+	lock.unlock();
+	if (unused) delete this;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run jobs until the scheduler stops
+////////////////////////////////////////////////////////////////////////////////
+void ObjectLODWorker::run() {
+	scheduler->getEditor()->getEditorWindow()->threadStarted();
+
+	ObjectLODGenerator* generator;
+	while ((generator = scheduler->takeJob())) {
+		scheduler->jobFinished(generator,generator->generate());
+	}
+
+	//qDebug("ObjectLODWorker::run: stopped");
+	scheduler->getEditor()->getEditorWindow()->threadEnded();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start worker threads of the document
+////////////////////////////////////////////////////////////////////////////////
+ObjectLODScheduler::ObjectLODScheduler(Editor* in_editor) {
+	editor = in_editor;
+	stopWorkers = false;
+	rendererPool = new ObjectRendererPool(sizeof(ObjectRenderer));
+	generatorPool = new ObjectRendererPool(sizeof(ObjectLODGenerator));
+	updateClock.start();
+	connect(&updateTimer, SIGNAL(timeout()), this, SLOT(processScheduledUpdates()));
+
+	if (fw_editor_settings->value("rendering.no_lods") == false) {
+		for (int i = 0; i < QThread::idealThreadCount(); i++) {
+			ObjectLODWorker* worker = new ObjectLODWorker(this);
+			workers.append(worker);
+			worker->start();
 		}
-		readingLock.unlock();
-		msleep(50);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stop workers. Generators remain until their renderers are destroyed
+////////////////////////////////////////////////////////////////////////////////
+ObjectLODScheduler::~ObjectLODScheduler() {
+	jobsLock.lock();
+		stopWorkers = true;
+		foreach (ObjectLODGenerator* generator, runningJobs) {
+			generator->stopWork();
+		}
+		jobsAvailable.wakeAll();
+	jobsLock.unlock();
+
+	for (int i = 0; i < workers.count(); i++) {
+		workers[i]->wait();
+		delete workers[i];
 	}
 
-	//Finish thread work and destroy HQ mesh
-	//qDebug("ObjectLODGenerator::run: stopped");
-	editor->getEditorWindow()->threadEnded();
+	foreach (ObjectLODGenerator* generator, removedGenerators) {
+		delete generator;
+	}
+	foreach (ObjectLODGenerator* generator, generators) {
+		generator->detachScheduler();
+	}
+
+	//Renderers and generators of the document may still be alive
+	rendererPool->detach();
+	generatorPool->detach();
 }
 
-QSemaphore ObjectLODGenerator::threadsSemaphore(QThread::idealThreadCount());
\ No newline at end of file
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectLODScheduler::removeGenerator(ObjectLODGenerator* generator) {
+	scheduledUpdates.remove(generator);
+	generators.remove(generator);
+
+	jobsLock.lock();
+		generator->stopWork();
+		if (queuedJobs.contains(generator)) {
+			queuedJobs.remove(generator);
+			jobs.removeAll(generator);
+		}
+		if (runningJobs.contains(generator)) {
+			removedGenerators.insert(generator);
+			generator = 0;
+		}
+	jobsLock.unlock();
+
+	if (generator) delete generator;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectLODScheduler::scheduleUpdate(ObjectLODGenerator* generator) {
+	scheduledUpdates[generator] = updateClock.elapsed() + FWE_LOD_UPDATE_DELAY;
+	if (!updateTimer.isActive()) updateTimer.start(FWE_LOD_UPDATE_INTERVAL);
+}
+
+void ObjectLODScheduler::processScheduledUpdates() {
+	int time = updateClock.elapsed();
+
+	//Find generators whose delay is over (updating them may schedule new updates)
+	QList<ObjectLODGenerator*> ready;
+	QMutableHashIterator<ObjectLODGenerator*,int> i(scheduledUpdates);
+	while (i.hasNext()) {
+		i.next();
+		if (i.value() <= time) {
+			ready.append(i.key());
+			i.remove();
+		}
+	}
+	if (scheduledUpdates.isEmpty()) updateTimer.stop();
+
+	for (int j = 0; j < ready.count(); j++) {
+		ready[j]->doUpdateMesh();
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Queue job, unless it's already queued or running (running job will be
+///  queued again once it's aborted)
+////////////////////////////////////////////////////////////////////////////////
+void ObjectLODScheduler::queueJob(ObjectLODGenerator* generator) {
+	jobsLock.lock();
+		if ((!queuedJobs.contains(generator)) && (!runningJobs.contains(generator))) {
+			queuedJobs.insert(generator);
+			jobs.enqueue(generator);
+			jobsAvailable.wakeOne();
+		}
+	jobsLock.unlock();
+}
+
+ObjectLODGenerator* ObjectLODScheduler::takeJob() {
+	ObjectLODGenerator* generator = 0;
+	jobsLock.lock();
+		while (jobs.isEmpty() && (!stopWorkers)) {
+			jobsAvailable.wait(&jobsLock);
+		}
+		if (!stopWorkers) {
+			generator = jobs.dequeue();
+			queuedJobs.remove(generator);
+			runningJobs.insert(generator);
+		}
+	jobsLock.unlock();
+	return generator;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Result is delivered while holding the lock, so the renderer can not be
+///  destroyed at the same time (pending call is discarded with the renderer).
+////////////////////////////////////////////////////////////////////////////////
+void ObjectLODScheduler::jobFinished(ObjectLODGenerator* generator, bool deliver) {
+	bool removed;
+	jobsLock.lock();
+		runningJobs.remove(generator);
+		removed = removedGenerators.remove(generator);
+		if (!removed) {
+			if (deliver) {
+				QMetaObject::invokeMethod(generator->getRenderer(),"lodMeshesGenerated",Qt::QueuedConnection);
+			}
+
+			//Another mesh was requested while this one was being generated
+			if (generator->isMeshNeeded() && (!stopWorkers)) {
+				queuedJobs.insert(generator);
+				jobs.enqueue(generator);
+				jobsAvailable.wakeOne();
+			}
+		}
+	jobsLock.unlock();
+
+	if (removed) delete generator;
+}
@@ -21,7 +21,14 @@
 
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QSemaphore>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QTime>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
 #include <GLC_Mesh>
 #include <GLC_3DViewInstance>
 
@@ -33,6 +40,8 @@ namespace EVDS {
 	class Editor;
 	class Object;
 	class ObjectLODGenerator;
+	class ObjectLODScheduler;
+	class ObjectRendererPool;
 	class ObjectRenderer : public QObject {
 		Q_OBJECT
 
@@ -40,9 +49,26 @@ namespace EVDS {
 		ObjectRenderer(Object* in_object);
 		~ObjectRenderer();
 
+		//Allocated from the pool of the document (see ObjectRendererPool)
+		static void* operator new(size_t size, ObjectRendererPool* pool);
+		static void operator delete(void* ptr, ObjectRendererPool* pool);
+		static void operator delete(void* ptr);
+
 		GLC_3DViewInstance* getInstance() { return glcInstance; }
 		GLC_3DRep* getRepresentation() { return glcMeshRep; }
 
+		//Residency management (finest LODs can be removed from the mesh to save memory)
+		int getNumLODs();
+		int getFirstResidentLOD() { return firstResidentLod; }
+		qint64 getLODBytes(int lod) { return lodBytes.value(lod); }
+		int getLODTriangles(int lod) { return lodTriangles.value(lod); }
+		qint64 getResidentBytes();
+		qint64 getCachedBytes() { return cachedBytes; }
+		//Rebuild mesh starting from the given LOD (returns false if mesh is busy)
+		bool setFirstResidentLOD(int lod);
+		//Drop copy of the mesh kept for reloading LODs (returns false if mesh is busy)
+		bool dropCachedMesh();
+
 	public slots:
 		//Notifies that objects mesh has changed and must be re-generated
 		void meshChanged();
@@ -60,6 +86,12 @@ namespace EVDS {
 		//Object to render
 		Object* object;
 		ObjectLODGenerator* lodMeshGenerator;
+
+		//Residency of LODs
+		int firstResidentLod;
+		QList<qint64> lodBytes;
+		QList<int> lodTriangles;
+		qint64 cachedBytes;
 	};
 
 
@@ -69,57 +101,188 @@ namespace EVDS {
 		QList<IndexList> indicesLists;
 		QList<EVDS_MESH*> meshList;
 		QList<int> lodList;
+		QList<int> lodVertexOffsets;
 
 		void clear();
+		bool isEmpty() { return verticesVector.isEmpty(); }
 		void appendMesh(EVDS_MESH* mesh, int lod);
-		void setGLCMesh(GLC_Mesh* glcMesh, Object* object);
+		void setGLCMesh(GLC_Mesh* glcMesh, Object* object, int firstLod = 0);
+		qint64 getLODBytes(int lod);
+		int getLODTriangles(int lod);
+		qint64 getBytes();
 	};
 
 
-	class ObjectLODGenerator : public QThread {
-		Q_OBJECT
-
+	//LOD meshes of a single object. Jobs are run by worker threads of the document
+	// (see ObjectLODScheduler), so there is no thread or timer for every object.
+	class ObjectLODGenerator {
 	public:
-		ObjectLODGenerator(Object* in_object, int in_lods);
+		ObjectLODGenerator(ObjectRenderer* in_renderer, Object* in_object, int in_lods, ObjectLODScheduler* in_scheduler);
+		~ObjectLODGenerator();
+
+		//Allocated from the pool of the document (see ObjectRendererPool)
+		static void* operator new(size_t size, ObjectRendererPool* pool);
+		static void operator delete(void* ptr, ObjectRendererPool* pool);
+		static void operator delete(void* ptr);
 
 		//Get mesh (returns 0 if mesh was not generated yet)
 		ObjectLODGeneratorResult* getResult();
 		//Update mesh for the given object
 		void updateMesh();
-		//Abort thread work
+		//Abort work
 		void stopWork();
-		//Locked when mesh is being generated
+		//Mark requested mesh as delivered (called after result was applied)
+		void finishJob();
+		//Locked while object copy or result are replaced
 		QMutex readingLock;
 
 		//Get number of lods
 		int getNumLODs() { return numLods; }
+		//Is there a requested mesh which was not delivered yet
+		bool isJobPending() { return jobPending; }
+		//Is a new mesh required (a copy of object is waiting for a worker)
+		bool isMeshNeeded() { return needMesh != 0; }
 
-		//Number of threads (for limiting total number of threads running at the same time)
-		static QSemaphore threadsSemaphore;
-
-	public slots:
+		//Copy object and queue job for the workers (called by scheduler once update delay is over)
 		void doUpdateMesh();
+		//Generate all LODs in a worker thread. Returns true if result must be delivered
+		bool generate();
 
-	signals:
-		void signalLODsReady();
+		//Get renderer which receives the result
+		ObjectRenderer* getRenderer() { return renderer; }
+		//Get scheduler (0 once document is closing)
+		ObjectLODScheduler* getScheduler() { return scheduler; }
+		void detachScheduler() { scheduler = 0; }
+
+		//Number of threads (for limiting total number of threads running at the same time)
+		static QSemaphore threadsSemaphore;
+		//Number of requested meshes which were not delivered yet (across all generators)
+		static int getPendingJobs() { return pendingJobs; }
+		//Number of jobs aborted because a newer mesh was requested (across all generators)
+		static int getAbortedJobs() { return abortedJobs; }
 
-	protected:
-		void run();
-	
 	private:
 		float getLODResolution(int lod); //Get resolution for LOD level
+		//Was job started at the given generation superseded or stopped
+		bool isJobCancelled(int generation) { return (doStopWork != 0) || (meshGeneration != generation); }
 
-		QTimer updateCallTimer;
-		bool doStopWork; //Stop threads work
-		bool needMesh; //Is new mesh required
+		QAtomicInt doStopWork; //Stop work (read by worker threads)
+		QAtomicInt meshGeneration; //Changed whenever the running job becomes stale
+		QAtomicInt needMesh; //Is new mesh required (read by worker threads)
+		bool jobPending; //Was mesh requested but not yet delivered
+		static QAtomicInt pendingJobs;
+		static QAtomicInt abortedJobs;
 
+		ObjectRenderer* renderer; //Renderer which receives generated meshes
 		Object* object; //Object for which mesh is generated
-		Editor* editor; //Objects editor
-		EVDS_OBJECT* object_copy; //Copy of the object for this thread
+		ObjectLODScheduler* scheduler; //Scheduler of the document
+		EVDS_OBJECT* object_copy; //Copy of the object for the worker
 
 		int numLods; //Total number of LODs
 		ObjectLODGeneratorResult result; //Generated meshes
 	};
+
+
+	//Storage for renderer state of a single document. Slots of the same size are
+	// allocated in blocks and reused, instead of allocating every object separately.
+	// Pool remains after the scheduler is destroyed until all slots are released
+	class ObjectRendererPool {
+	public:
+		ObjectRendererPool(size_t in_slotSize);
+
+		//Get storage for an object (uses the heap if there is no pool)
+		static void* allocate(ObjectRendererPool* pool, size_t size);
+		//Return storage to the pool it was allocated from
+		static void release(void* ptr);
+		//Owner no longer uses the pool, it's deleted once all slots are released
+		void detach();
+
+	private:
+		~ObjectRendererPool();
+		void releaseSlot(char* slot);
+
+		QMutex lock; //Slots are released by worker threads too
+		size_t slotSize;
+		QList<char*> blocks;
+		QList<char*> freeSlots;
+		int usedSlots;
+		bool detached;
+	};
+
+
+	class ObjectLODWorker : public QThread {
+		Q_OBJECT
+
+	public:
+		ObjectLODWorker(ObjectLODScheduler* in_scheduler) { scheduler = in_scheduler; }
+
+	protected:
+		void run();
+
+	private:
+		ObjectLODScheduler* scheduler;
+	};
+
+
+	//Runs LOD jobs of all objects in a document on a small number of worker threads
+	class ObjectLODScheduler : public QObject {
+		Q_OBJECT
+
+	public:
+		ObjectLODScheduler(Editor* in_editor);
+		~ObjectLODScheduler();
+
+		//Are LOD meshes generated at all
+		bool isEnabled() { return !workers.isEmpty(); }
+		Editor* getEditor() { return editor; }
+
+		//Pools for renderers and generators of the document
+		ObjectRendererPool* getRendererPool() { return rendererPool; }
+		ObjectRendererPool* getGeneratorPool() { return generatorPool; }
+
+		//Generator is being destroyed (deleted right away, or once its job is aborted)
+		void removeGenerator(ObjectLODGenerator* generator);
+		//Update mesh after a short delay (repeated requests restart the delay)
+		void scheduleUpdate(ObjectLODGenerator* generator);
+		bool isUpdateScheduled(ObjectLODGenerator* generator) { return scheduledUpdates.contains(generator); }
+
+		//Add job for worker threads
+		void queueJob(ObjectLODGenerator* generator);
+		//Get next job for a worker thread (waits until there is one, returns 0 if workers must stop)
+		ObjectLODGenerator* takeJob();
+		//Worker has finished the job, deliver result to the renderer
+		void jobFinished(ObjectLODGenerator* generator, bool deliver);
+
+	private slots:
+		void processScheduledUpdates();
+
+	private:
+		Editor* editor;
+
+		//Generators waiting for the update delay to end (time at which the delay ends)
+		QHash<ObjectLODGenerator*,int> scheduledUpdates;
+		QTimer updateTimer;
+		QTime updateClock;
+
+		//Jobs for worker threads (protected by jobsLock)
+		QMutex jobsLock;
+		QWaitCondition jobsAvailable;
+		QQueue<ObjectLODGenerator*> jobs;
+		QSet<ObjectLODGenerator*> queuedJobs;
+		QSet<ObjectLODGenerator*> runningJobs;
+		QSet<ObjectLODGenerator*> removedGenerators; //Deleted once their job ends
+		bool stopWorkers;
+
+		//All generators of the document
+		QSet<ObjectLODGenerator*> generators;
+		QList<ObjectLODWorker*> workers;
+
+		//Storage for renderer state
+		ObjectRendererPool* rendererPool;
+		ObjectRendererPool* generatorPool;
+
+		friend class ObjectLODGenerator;
+	};
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,373 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QTimer>
+#include <QTime>
+#include <QPair>
+#include <QtAlgorithms>
+
+#include "fwe_main.h"
+#include "fwe_evds.h"
+#include "fwe_evds_object.h"
+#include "fwe_evds_object_renderer.h"
+#include "fwe_evds_residency.h"
+#include "fwe_glscene.h"
+
+using namespace EVDS;
+
+//Maximum number of meshes rebuilt during one update
+#define FWE_RESIDENCY_MAX_REBUILDS		32
+//Minimum size on screen (fraction of view height) for evicted LODs to be reloaded
+#define FWE_RESIDENCY_RELOAD_SIZE		0.05
+//Fraction of budget which must remain free after reloading LODs
+#define FWE_RESIDENCY_RELOAD_MARGIN		0.9
+//Time spent generating queued meshes before returning control to the interface (msec)
+#define FWE_RESIDENCY_QUEUE_TIME		25
+//Minimum size on screen (fraction of view height) for children of collapsed objects to be created
+#define FWE_RESIDENCY_EXPAND_SIZE		0.1
+
+QList<MeshResidencyManager*> MeshResidencyManager::managers;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Keeps memory used by object meshes under the configured budget.
+///
+/// Finest LODs of objects which are small on screen or outside of the view are
+/// removed from their meshes, and reloaded from the copy kept by the LOD generator
+/// once the object becomes large enough. If the copy was dropped from the cache,
+/// the mesh is generated again.
+////////////////////////////////////////////////////////////////////////////////
+MeshResidencyManager::MeshResidencyManager(Editor* in_editor) {
+	editor = in_editor;
+	updateCounter = 0;
+	cacheHits = 0;
+	cacheMisses = 0;
+	managers.append(this);
+
+	QTimer *timer = new QTimer(this);
+	connect(timer, SIGNAL(timeout()), this, SLOT(updateResidency()));
+	timer->start(1000);
+
+	deferMeshes = false;
+	queueCounter = 0;
+	queueTotal = 0;
+	connect(&queueTimer, SIGNAL(timeout()), this, SLOT(processQueue()));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshResidencyManager::~MeshResidencyManager() {
+	managers.removeAll(this);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::meshLoaded(ObjectRenderer* renderer) {
+	renderers[renderer] = updateCounter;
+}
+
+void MeshResidencyManager::meshRemoved(ObjectRenderer* renderer) {
+	renderers.remove(renderer);
+	queuedMeshes.remove(renderer);
+}
+
+void MeshResidencyManager::meshReloaded(ObjectRenderer* renderer, bool fromCache) {
+	renderers[renderer] = updateCounter;
+	if (fromCache) {
+		cacheHits++;
+	} else {
+		cacheMisses++;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshResidencyStatistics MeshResidencyManager::getStatistics() {
+	MeshResidencyStatistics stats = { 0 };
+	stats.budgetBytes = ((qint64)fw_editor_settings->value("rendering.mesh_budget").toInt())*1024*1024;
+	stats.cacheBudgetBytes = ((qint64)fw_editor_settings->value("rendering.mesh_cache_budget").toInt())*1024*1024;
+	stats.meshes = renderers.count();
+	stats.cacheHits = cacheHits;
+	stats.cacheMisses = cacheMisses;
+	stats.queuedMeshes = queuedMeshes.count();
+
+	QHashIterator<ObjectRenderer*,int> i(renderers);
+	while (i.hasNext()) {
+		i.next();
+		stats.residentBytes += i.key()->getResidentBytes();
+		stats.cachedBytes += i.key()->getCachedBytes();
+		stats.evictedLODs += i.key()->getFirstResidentLOD();
+	}
+	return stats;
+}
+
+MeshResidencyStatistics MeshResidencyManager::getTotalStatistics() {
+	MeshResidencyStatistics total = { 0 };
+	for (int i = 0; i < managers.count(); i++) {
+		MeshResidencyStatistics stats = managers[i]->getStatistics();
+		total.residentBytes += stats.residentBytes;
+		total.cachedBytes += stats.cachedBytes;
+		total.meshes += stats.meshes;
+		total.evictedLODs += stats.evictedLODs;
+		total.cacheHits += stats.cacheHits;
+		total.cacheMisses += stats.cacheMisses;
+		total.queuedMeshes += stats.queuedMeshes;
+		total.budgetBytes = stats.budgetBytes;
+		total.cacheBudgetBytes = stats.cacheBudgetBytes;
+	}
+	return total;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count triangles of visible objects. GLC may draw coarser LODs of small
+///  objects, so this is an upper bound of the triangles drawn in a frame.
+////////////////////////////////////////////////////////////////////////////////
+qint64 MeshResidencyManager::getTrianglesInView() {
+	GLScene* glscene = editor->getGLScene();
+
+	qint64 triangles = 0;
+	QHashIterator<ObjectRenderer*,int> i(renderers);
+	while (i.hasNext()) {
+		i.next();
+		if (glscene->isInView(i.key()->getInstance())) {
+			triangles += i.key()->getLODTriangles(i.key()->getFirstResidentLOD());
+		}
+	}
+	return triangles;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Meshes are queued while objects of a loaded file are created, and
+///  generated in small portions once all objects exist.
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::setDeferMeshes(bool defer) {
+	deferMeshes = defer;
+	if (!deferMeshes) {
+		if (!queuedMeshes.isEmpty()) queueTimer.start(0);
+		emit queueProgress(queueTotal - queuedMeshes.count(),queueTotal);
+	}
+}
+
+bool MeshResidencyManager::queueMesh(ObjectRenderer* renderer) {
+	if (!deferMeshes) {
+		queuedMeshes.remove(renderer); //Mesh is generated now, no need to do it later
+		return false;
+	}
+
+	if (!queuedMeshes.contains(renderer)) {
+		queuedMeshes[renderer] = queueCounter++;
+		queueTotal++;
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collapsed objects are expanded once they become large enough on screen
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::collapsedObjectAdded(Object* object) {
+	collapsedObjects.insert(object);
+}
+
+void MeshResidencyManager::collapsedObjectRemoved(Object* object) {
+	collapsedObjects.remove(object);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create children of collapsed objects which take up a noticeable part
+///  of the view, largest objects first. Continues later if time runs out.
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::createVisibleChildren() {
+	if (collapsedObjects.isEmpty()) return;
+	if (!editor->getActive()) return;
+	GLScene* glscene = editor->getGLScene();
+
+	//Estimate size of every collapsed subtree on screen
+	QList<QPair<double,Object*> > order;
+	foreach (Object* object, collapsedObjects) {
+		GLC_3DViewInstance* instance = object->getRenderer()->getInstance();
+		if (!instance->isVisible()) continue;
+
+		//Subtree is centered on the object origin, and must contain object own mesh
+		GLC_Point3d center = instance->matrix() * GLC_Point3d(0.0,0.0,0.0);
+		double radius = object->getCollapsedRadius();
+		GLC_BoundingBox box = instance->boundingBox();
+		if (!box.isEmpty()) {
+			radius = qMax(radius,(box.center() - center).length() + box.boundingSphereRadius());
+		}
+
+		double fraction = glscene->getScreenFraction(center,radius);
+		if (fraction >= FWE_RESIDENCY_EXPAND_SIZE) order.append(qMakePair(-fraction,object));
+	}
+	qSort(order);
+
+	//Create children until time runs out
+	QTime time;
+	time.start();
+	int i;
+	for (i = 0; (i < order.count()) && (time.elapsed() < FWE_RESIDENCY_QUEUE_TIME); i++) {
+		if (!collapsedObjects.contains(order[i].second)) continue;
+		editor->getEditorWindow()->createChildren(order[i].second);
+	}
+	if (i < order.count()) QTimer::singleShot(0,this,SLOT(createVisibleChildren()));
+	if (i > 0) glscene->invalidate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Generate queued meshes. Objects inside of the view go first, then
+///  objects outside of it, then hidden objects (each in order they were created).
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::processQueue() {
+	GLScene* glscene = editor->getGLScene();
+
+	QList<QPair<QPair<int,int>,ObjectRenderer*> > order;
+	QHashIterator<ObjectRenderer*,int> iterator(queuedMeshes);
+	while (iterator.hasNext()) {
+		iterator.next();
+		GLC_3DViewInstance* instance = iterator.key()->getInstance();
+
+		int priority = 2;
+		if (instance->isVisible()) priority = glscene->isInView(instance) ? 0 : 1;
+		order.append(qMakePair(qMakePair(priority,iterator.value()),iterator.key()));
+	}
+	qSort(order);
+
+	//Generate meshes until time runs out
+	QTime time;
+	time.start();
+	for (int i = 0; (i < order.count()) && (time.elapsed() < FWE_RESIDENCY_QUEUE_TIME); i++) {
+		queuedMeshes.remove(order[i].second);
+		order[i].second->meshChanged();
+	}
+
+	//Report progress, stop when finished
+	emit queueProgress(queueTotal - queuedMeshes.count(),queueTotal);
+	if (queuedMeshes.isEmpty()) {
+		queueTimer.stop();
+		queueCounter = 0;
+		queueTotal = 0;
+	}
+	glscene->invalidate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Evict or reload LODs depending on how large objects are on screen
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::updateResidency() {
+	updateCounter++;
+	if (!editor->getActive()) return;
+	createVisibleChildren();
+
+	qint64 budget = ((qint64)fw_editor_settings->value("rendering.mesh_budget").toInt())*1024*1024;
+	GLScene* glscene = editor->getGLScene();
+
+	//Sort meshes by their size on screen, remember when visible meshes were last used
+	QList<QPair<double,ObjectRenderer*> > order;
+	qint64 resident = 0;
+	QMutableHashIterator<ObjectRenderer*,int> iterator(renderers);
+	while (iterator.hasNext()) {
+		iterator.next();
+		double fraction = glscene->getScreenFraction(iterator.key()->getInstance());
+		if (fraction > 0.0) iterator.setValue(updateCounter);
+		order.append(qMakePair(fraction,iterator.key()));
+		resident += iterator.key()->getResidentBytes();
+	}
+	qSort(order);
+
+	//Evict finest LODs of the smallest objects until everything fits into budget
+	int rebuilds = 0;
+	for (int i = 0; (i < order.count()) && (budget > 0) && (resident > budget); i++) {
+		if (rebuilds >= FWE_RESIDENCY_MAX_REBUILDS) break;
+
+		ObjectRenderer* renderer = order[i].second;
+		int lod = renderer->getFirstResidentLOD();
+		qint64 freed = 0;
+		while ((lod < renderer->getNumLODs()-1) && (resident - freed > budget)) {
+			freed += renderer->getLODBytes(lod);
+			lod++;
+		}
+		if ((lod != renderer->getFirstResidentLOD()) && renderer->setFirstResidentLOD(lod)) {
+			resident -= freed;
+			rebuilds++;
+		}
+	}
+
+	//Reload LODs of the largest objects while there is enough free space
+	for (int i = order.count()-1; i >= 0; i--) {
+		if (rebuilds >= FWE_RESIDENCY_MAX_REBUILDS) break;
+		if ((budget > 0) && (order[i].first < FWE_RESIDENCY_RELOAD_SIZE)) break;
+
+		ObjectRenderer* renderer = order[i].second;
+		if (renderer->getFirstResidentLOD() == 0) continue;
+
+		qint64 needed = 0;
+		for (int lod = 0; lod < renderer->getFirstResidentLOD(); lod++) {
+			needed += renderer->getLODBytes(lod);
+		}
+		if ((budget > 0) && (resident + needed > budget*FWE_RESIDENCY_RELOAD_MARGIN)) continue;
+		if (renderer->setFirstResidentLOD(0)) {
+			resident += needed;
+			rebuilds++;
+		}
+	}
+
+	//Redraw with new meshes
+	if (rebuilds > 0) glscene->invalidate();
+	trimCache();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void MeshResidencyManager::trimCache() {
+	qint64 budget = ((qint64)fw_editor_settings->value("rendering.mesh_cache_budget").toInt())*1024*1024;
+	if (budget <= 0) return;
+
+	//Sort cached copies by the time they were last used
+	QList<QPair<int,ObjectRenderer*> > order;
+	qint64 cached = 0;
+	QHashIterator<ObjectRenderer*,int> iterator(renderers);
+	while (iterator.hasNext()) {
+		iterator.next();
+		if (iterator.key()->getCachedBytes() > 0) {
+			order.append(qMakePair(iterator.value(),iterator.key()));
+			cached += iterator.key()->getCachedBytes();
+		}
+	}
+	qSort(order);
+
+	//Drop least recently used copies
+	for (int i = 0; (i < order.count()) && (cached > budget); i++) {
+		qint64 bytes = order[i].second->getCachedBytes();
+		if (order[i].second->dropCachedMesh()) {
+			cached -= bytes;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_RESIDENCY_H
+#define FWE_EVDS_RESIDENCY_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QTimer>
+
+namespace EVDS {
+	class Editor;
+	class ObjectRenderer;
+	class Object;
+	struct MeshResidencyStatistics {
+		qint64 residentBytes;	//Mesh data used for rendering
+		qint64 budgetBytes;		//Budget for mesh data used for rendering
+		qint64 cachedBytes;		//Copies of meshes kept for reloading evicted LODs
+		qint64 cacheBudgetBytes;//Budget for copies of meshes
+		int meshes;				//Number of managed meshes
+		int evictedLODs;		//Total number of LODs removed from meshes
+		int cacheHits;			//LODs reloaded from cached copy
+		int cacheMisses;		//LODs which had to be generated again
+		int queuedMeshes;		//Meshes waiting to be generated after loading a file
+	};
+	class MeshResidencyManager : public QObject {
+		Q_OBJECT
+
+	public:
+		MeshResidencyManager(Editor* in_editor);
+		~MeshResidencyManager();
+
+		//Mesh with all LODs was generated for the renderer
+		void meshLoaded(ObjectRenderer* renderer);
+		//Renderer is being destroyed
+		void meshRemoved(ObjectRenderer* renderer);
+		//LODs were reloaded from cached copy (or copy was missing)
+		void meshReloaded(ObjectRenderer* renderer, bool fromCache);
+
+		//Queue meshes instead of generating them (while objects of a file are created)
+		void setDeferMeshes(bool defer);
+		//Queue mesh if meshes are deferred. Returns false if mesh must be generated right away
+		bool queueMesh(ObjectRenderer* renderer);
+
+		//Object was created with its children collapsed
+		void collapsedObjectAdded(Object* object);
+		//Children of the object were created, or object is being destroyed
+		void collapsedObjectRemoved(Object* object);
+
+		//Get statistics for this editor
+		MeshResidencyStatistics getStatistics();
+		//Get statistics summed over all editors
+		static MeshResidencyStatistics getTotalStatistics();
+		//Get number of triangles in finest resident LODs of visible objects inside of the view
+		qint64 getTrianglesInView();
+
+	signals:
+		//Progress of generating queued meshes
+		void queueProgress(int done, int total);
+
+	private slots:
+		void updateResidency();
+		//Generate queued meshes, visible objects first
+		void processQueue();
+		//Create children of collapsed objects which became large on screen
+		void createVisibleChildren();
+
+	private:
+		//Drop least recently used copies of meshes until cache fits into budget
+		void trimCache();
+
+		//EVDS editor
+		Editor* editor;
+		//Managed renderers and the last time they were used
+		QHash<ObjectRenderer*,int> renderers;
+		//Current update number
+		int updateCounter;
+		//Cache statistics
+		int cacheHits;
+		int cacheMisses;
+
+		//Meshes waiting to be generated (with the order in which they were queued)
+		QHash<ObjectRenderer*,int> queuedMeshes;
+		QTimer queueTimer;
+		bool deferMeshes;
+		int queueCounter;
+		int queueTotal;
+
+		//Objects with children that were not created yet
+		QSet<Object*> collapsedObjects;
+
+		//All residency managers (one per editor)
+		static QList<MeshResidencyManager*> managers;
+	};
+}
+
+#endif
@@ -40,7 +40,8 @@ ObjectList::ObjectList(Object* root, QWidget* parent) : QDockWidget(tr("Objects
 	model = new ObjectTreeModel(root->getEditorWindow(),root,this);
 	object_tree = new QTreeView(this);
 	object_tree->setModel(model);
-	object_tree->expandAll();
+	object_tree->setSelectionMode(QAbstractItemView::ExtendedSelection);
+	expandObjects(QModelIndex());
 	object_tree->setColumnWidth(0,150);
 
 	//Setup drag and drop
@@ -72,6 +73,29 @@ ObjectList::ObjectList(Object* root, QWidget* parent) : QDockWidget(tr("Objects
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectList::reloadObjects() {
+	model->reloadObjects();
+	expandObjects(QModelIndex());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectList::expandObjects(const QModelIndex& index) {
+	if (index.isValid()) {
+		if (model->canFetchMore(index)) return;
+		object_tree->expand(index);
+	}
+	for (int i = 0; i < model->rowCount(index); i++) {
+		expandObjects(model->index(i,0,index));
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,7 +45,10 @@ namespace Dock {
 
 		void setCurrentIndex(QModelIndex index) { object_tree->setCurrentIndex(index); }
 		QModelIndex currentIndex() { return object_tree->selectionModel()->currentIndex(); }
+		QModelIndexList selectedIndexes() { return object_tree->selectionModel()->selectedRows(); }
 		EVDS::ObjectTreeModel* getModel() { return model; }
+		//Show objects after hierarchy was replaced
+		void reloadObjects();
 
 		void showButtons();
 		void hideButtons();
@@ -61,6 +64,9 @@ namespace Dock {
 		void doSelectObject(const QModelIndex& index) { selectObject(index); }
 
 	private:
+		//Expand all objects except collapsed ones (expanding those creates their children)
+		void expandObjects(const QModelIndex& index);
+
 		EVDS::ObjectTreeModel*	model;
 		QWidget*				form;
 		QTreeView*				object_tree;
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QDockWidget>
+#include <QFormLayout>
+#include <QLabel>
+
+#include "fwe_evds.h"
+#include "fwe_evds_object.h"
+#include "fwe_evds_object_renderer.h"
+#include "fwe_evds_modifiers.h"
+#include "fwe_evds_residency.h"
+#include "fwe_glscene.h"
+#include "fwe_dock_performance.h"
+
+using namespace EVDS;
+using namespace Dock;
+
+//Interval between updates of the counters
+#define FWE_PERFORMANCE_UPDATE_INTERVAL	500
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Live counters of the editor pipeline
+////////////////////////////////////////////////////////////////////////////////
+Performance::Performance(EVDS::Editor* in_editor, QWidget* parent) : QDockWidget(tr("Performance"),parent) {
+	editor = in_editor;
+
+	//Set dock properties
+	setFeatures(QDockWidget::AllDockWidgetFeatures);
+	setAllowedAreas(Qt::AllDockWidgetAreas);
+
+	//Create form and layout
+	form = new QWidget();
+	form->setMinimumWidth(250);
+	form->setMinimumHeight(80);
+	setWidget(form);
+
+	layout = new QFormLayout;
+	form->setLayout(layout);
+
+	//Create counters
+	active_threads = addCounter(tr("Worker threads:"));
+	lod_jobs = addCounter(tr("LOD jobs:"));
+	mesh_cache = addCounter(tr("Mesh cache:"));
+	mesh_memory = addCounter(tr("Mesh memory:"));
+	modifier_instances = addCounter(tr("Modifier instances:"));
+	scene_instances = addCounter(tr("Scene instances:"));
+	triangles = addCounter(tr("Triangles in view:"));
+	solve_time = addCounter(tr("Last solve:"));
+
+	//Update counters periodically
+	connect(&updateTimer, SIGNAL(timeout()), this, SLOT(updateCounters()));
+	updateTimer.start(FWE_PERFORMANCE_UPDATE_INTERVAL);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QLabel* Performance::addCounter(const QString& name) {
+	QLabel* label = new QLabel("-");
+	label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+	layout->addRow(name,label);
+	return label;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Performance::updateCounters() {
+	if (!isVisible() || !editor->getActive()) return;
+
+	MeshResidencyStatistics stats = editor->getResidencyManager()->getStatistics();
+	int reloads = stats.cacheHits + stats.cacheMisses;
+
+	active_threads->setText(tr("%1 running, %2 of %3 generating meshes")
+		.arg(editor->getEditorWindow()->getActiveThreads())
+		.arg(QThread::idealThreadCount() - ObjectLODGenerator::threadsSemaphore.available())
+		.arg(QThread::idealThreadCount()));
+	lod_jobs->setText(tr("%1 queued, %2 pending, %3 aborted")
+		.arg(stats.queuedMeshes)
+		.arg(ObjectLODGenerator::getPendingJobs())
+		.arg(ObjectLODGenerator::getAbortedJobs()));
+	if (reloads > 0) {
+		mesh_cache->setText(tr("%1% hit rate (%2 of %3 reloads)")
+			.arg(100.0*stats.cacheHits/reloads,0,'f',1)
+			.arg(stats.cacheHits)
+			.arg(reloads));
+	} else {
+		mesh_cache->setText(tr("no reloads"));
+	}
+	mesh_memory->setText(tr("%1 MB in %2 meshes, %3 MB cached")
+		.arg(stats.residentBytes/(1024.0*1024.0),0,'f',1)
+		.arg(stats.meshes)
+		.arg(stats.cachedBytes/(1024.0*1024.0),0,'f',1));
+	modifier_instances->setText(QString::number(editor->getModifiersManager()->getInstanceCount()));
+	scene_instances->setText(QString::number(editor->getGLScene()->getCollection()->size()));
+	triangles->setText(QString::number(editor->getResidencyManager()->getTrianglesInView()));
+
+	int time = editor->getInitializer()->getLastSolveTime();
+	if (time >= 0) {
+		solve_time->setText(tr("%1 msec").arg(time));
+	} else {
+		solve_time->setText(tr("not solved yet"));
+	}
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_DOCK_PERFORMANCE_H
+#define FWE_DOCK_PERFORMANCE_H
+
+#include <QDockWidget>
+#include <QTimer>
+
+QT_BEGIN_NAMESPACE
+class QWidget;
+class QLabel;
+class QFormLayout;
+QT_END_NAMESPACE
+
+
+////////////////////////////////////////////////////////////////////////////////
+namespace EVDS {
+	class Editor;
+}
+namespace Dock {
+	class Performance : public QDockWidget {
+		Q_OBJECT
+
+	public:
+		Performance(EVDS::Editor* in_editor, QWidget* parent);
+
+	private slots:
+		//Read counters again (only while the dock is visible)
+		void updateCounters();
+
+	private:
+		QLabel* addCounter(const QString& name);
+
+		EVDS::Editor*	editor;
+		QWidget*		form;
+		QFormLayout*	layout;
+		QTimer			updateTimer;
+
+		QLabel*			active_threads;
+		QLabel*			lod_jobs;
+		QLabel*			mesh_cache;
+		QLabel*			mesh_memory;
+		QLabel*			modifier_instances;
+		QLabel*			scene_instances;
+		QLabel*			triangles;
+		QLabel*			solve_time;
+	};
+}
+
+#endif
@@ -18,11 +18,17 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <QtGui>
 
+#include "fwe.h"
 #include "fwe_main.h"
+#include "fwe_editor_io.h"
+#include "fwe_editor_journal.h"
 #include "fwe_glscene.h"
 #include "fwe_evds.h"
 #include "fwe_evds_object.h"
+#include "fwe_evds_modifiers.h"
+#include "fwe_evds_residency.h"
 #include "fwe_schematics.h"
+#include "fwe_schematics_renderer.h"
 #include "fwe_dialog_preferences.h"
 
 using namespace FWE;
@@ -54,8 +60,11 @@ EditorWindow::EditorWindow(MainWindow* window) : activeThreads(0) {
 	EVDS_Object_Create(inertial_root,&root);
 	EVDS_Object_SetType(root,"rigid_body"); //Allows finding out parameters for the entire file
 	root_object = new EVDS::Object(root,0,this);
+	journal = new Journal(root_object);
+	compacting = false;
 
-	//Create EVDS editor
+	//Create EVDS editor (objects changed while it's created are not sent to it)
+	EVDSEditor = 0;
 	EVDSEditor = new EVDS::Editor(this);
 	editorsLayout->addWidget(EVDSEditor);
 	EVDSEditor->setActive(true);
@@ -69,15 +78,33 @@ EditorWindow::EditorWindow(MainWindow* window) : activeThreads(0) {
 	//Delete child on close
 	setAttribute(Qt::WA_DeleteOnClose);
 
-	//Enable autosave for this window
-	QTimer *timer = new QTimer(this);
-	connect(timer, SIGNAL(timeout()), this, SLOT(autoSave()));
-	timer->start(fw_editor_settings->value("ui.autosave").toInt());
+	//Enable autosave for this window (files are never modified in headless mode)
+	QTimer *timer;
+	if (!(fw_editor_flags & FOXWORKS_EDITOR_HEADLESS)) {
+		timer = new QTimer(this);
+		connect(timer, SIGNAL(timeout()), this, SLOT(autoSave()));
+		timer->start(fw_editor_settings->value("ui.autosave").toInt());
+	}
 
 	//Clear EVDS objects no longer used in other threads
 	timer = new QTimer(this);
 	connect(timer, SIGNAL(timeout()), this, SLOT(cleanupTimer()));
 	timer->start(1000);
+
+	//Progress of loading files is shown in status bar of the window
+	loader = 0;
+	loadingFailed = false;
+	lazyLoading = false;
+	batchUpdates = 0;
+	saver = 0;
+	autoSaveNeeded = false;
+	documentCreated = false;
+	loadingProgress = new QProgressBar(this);
+	loadingProgress->setMaximumWidth(200);
+	statusBar()->addPermanentWidget(loadingProgress);
+	statusBar()->hide();
+	connect(&loadingTimer, SIGNAL(timeout()), this, SLOT(updateLoadingProgress()));
+	connect(EVDSEditor->getResidencyManager(), SIGNAL(queueProgress(int,int)), this, SLOT(meshQueueProgress(int,int)));
 }
 
 
@@ -85,6 +112,18 @@ EditorWindow::EditorWindow(MainWindow* window) : activeThreads(0) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 EditorWindow::~EditorWindow() {
+	if (loader) {
+		qDebug("EditorWindow::~EditorWindow: waiting for file loader");
+		loader->wait();
+		delete loader;
+		loader = 0;
+	}
+	if (saver) {
+		qDebug("EditorWindow::~EditorWindow: waiting for autosave");
+		saver->wait();
+		saverFinished();
+	}
+
 	qDebug("EditorWindow::~EditorWindow: destroying editors");
 	delete EVDSEditor;
 	delete SchematicsEditor;
@@ -95,6 +134,7 @@ EditorWindow::~EditorWindow() {
 	while (activeThreads.available() > 0) ;
 
 	qDebug("EditorWindow::~EditorWindow: cleaning up EVDS objects");
+	delete journal;
 	delete root_object;
 
 	qDebug("EditorWindow::~EditorWindow: destroying system");
@@ -228,6 +268,7 @@ void EditorWindow::cleanupTimer() {
 ////////////////////////////////////////////////////////////////////////////////
 void EditorWindow::newFile() {
 	isModified = false;
+	lazyLoading = false;
 	currentFile = "";
 	updateTitle();
 
@@ -245,52 +286,150 @@ void EditorWindow::newFile() {
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-int FWE_LoadFile_OnSyntaxError(EVDS_OBJECT_LOADEX* info, const char* error) {
-	EditorWindow* editor = (EditorWindow*)info->userdata;
-	editor->showLoadingError(QString(error));
-	return EVDS_OK;
-}
-
 void EditorWindow::showLoadingError(const QString& errorMessage) {
-	QApplication::restoreOverrideCursor();
+	if (fw_editor_flags & FOXWORKS_EDITOR_HEADLESS) {
+		qWarning("Cannot read file %s (syntax error): %s",
+			currentFile.toUtf8().data(),errorMessage.toUtf8().data());
+		return;
+	}
 	QMessageBox::warning(this, tr("FoxWorks Editor"),
 						 tr("Cannot read file %1 (syntax error):\n%2.")
 						 .arg(QFileInfo(currentFile).fileName())
 						 .arg(errorMessage));
 }
 
+void EditorWindow::showReadError() {
+	if (fw_editor_flags & FOXWORKS_EDITOR_HEADLESS) {
+		qWarning("Cannot read file %s: file not found or not readable",currentFile.toUtf8().data());
+		return;
+	}
+	QMessageBox::warning(this, tr("FoxWorks Editor"),
+						 tr("Cannot read file %1:\nFile not found or not readable.")
+						 .arg(currentFile));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start reading file in background.
+///
+/// The editor is disabled until the file is read. Once it is, the objects hierarchy
+/// is created right away, and meshes are generated afterwards, starting with
+/// objects which are visible. Returns false if file cannot be opened at all.
+////////////////////////////////////////////////////////////////////////////////
 bool EditorWindow::loadFile(const QString &fileName) {
 	isModified = false;
 	currentFile = fileName;
 	updateTitle();
 
-	//Enable loading cursor
-	QApplication::setOverrideCursor(Qt::WaitCursor);
+	//Check if file can be read before starting
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		showReadError();
+		return false;
+	}
+	file.close();
 
-	//Load EVDS data structures
-	EVDS_OBJECT_LOADEX info = { 0 };
-	info.OnSyntaxError = &FWE_LoadFile_OnSyntaxError;
-	info.userdata = (void*)this;
+	//Load EVDS data structures in a separate thread
+	editorsWidget->setEnabled(false);
+	loader = new FileLoader(root,fileName,fw_editor_settings->value("ui.journal_saves").toBool());
+	connect(loader, SIGNAL(finished()), this, SLOT(fileLoaded()));
+	loader->start();
 
-	int error_code = EVDS_Object_LoadEx(root,fileName.toUtf8().data(),&info);
+	//Show progress
+	loadingProgress->setRange(0,0);
+	statusBar()->show();
+	loadingTimer.start(100);
+	updateLoadingProgress();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create objects after the file was read
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::fileLoaded() {
+	int error_code = loader->getErrorCode();
+	QString syntax_error = loader->getSyntaxError();
+	QByteArray file_stamp = loader->getFileStamp();
+	int journal_deltas = loader->getJournalDeltas();
+	qint64 journal_length = loader->getJournalLength();
+	int loader_objects = loader->getLoadedObjects();
+	EVDS_OBJECT* loaded = loader->takeLoadedObject();
+	loader->deleteLater();
+	loader = 0;
+	loadingTimer.stop();
+
+	//Report errors, close the window if file could not be read
+	if (!syntax_error.isEmpty()) showLoadingError(syntax_error);
 	if (error_code != EVDS_OK) {
-		if (error_code != EVDS_ERROR_SYNTAX) {
-			QApplication::restoreOverrideCursor();
-			QMessageBox::warning(this, tr("FoxWorks Editor"),
-								 tr("Cannot read file %1:\nFile not found or not readable.")
-								 .arg(fileName));
-		}
-		return false;
-
+		if (error_code != EVDS_ERROR_SYNTAX) showReadError();
+		if (loaded) EVDS_Object_Destroy(loaded);
+		loadingFailed = true;
+		statusBar()->hide();
+		close();
+		return;
 	}
 
-	//Initialize the root object
+	//Initialize the root object. Meshes are queued, so only the hierarchy is created here
+	statusBar()->showMessage(tr("Creating objects..."));
+	QApplication::setOverrideCursor(Qt::WaitCursor);
+	EVDSEditor->getResidencyManager()->setDeferMeshes(true);
+	int lazy_loading_objects = fw_editor_settings->value("ui.lazy_loading_objects").toInt();
+	lazyLoading = (lazy_loading_objects > 0) && (loader_objects >= lazy_loading_objects);
+
+	//Move objects read by the loader into the root
+	if (loaded) {
+		QList<EVDS_OBJECT*> children;
+		SIMC_LIST* list;
+		SIMC_LIST_ENTRY* entry;
+		EVDS_Object_GetAllChildren(loaded,&list);
+		entry = SIMC_List_GetFirst(list);
+		while (entry) {
+			children.append((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+			entry = SIMC_List_GetNext(list,entry);
+		}
+		for (int i = 0; i < children.count(); i++) {
+			EVDS_Object_SetParent(children[i],root);
+		}
+		EVDS_Object_Destroy(loaded);
+	}
+
+	//Create metadata object if the file has none. It's created without marking the file modified,
+	// and only journaled with the first change
+	documentCreated = true;
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+	EVDS_Object_GetAllChildren(root,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		char type[257] = { 0 };
+		EVDS_Object_GetType((EVDS_OBJECT*)SIMC_List_GetData(list,entry),type,256);
+		if (strcmp(type,"metadata") == 0) documentCreated = false;
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	if (documentCreated) {
+		EVDS_OBJECT* metadata;
+		EVDS_Object_Create(root,&metadata);
+		EVDS_Object_SetType(metadata,"metadata");
+		EVDS_Object_SetName(metadata,"");
+	}
 	root_object->invalidateChildren();
 
+	//Continue journal of the file if changes were read from it. Without journaled saves
+	// changes are not recorded at all
+	bool useJournal = fw_editor_settings->value("ui.journal_saves").toBool();
+	if (!useJournal) {
+		if (journal_deltas == 0) journal->reset(currentFile,QByteArray());
+	} else if (journal_deltas > 0) {
+		journal->resume(currentFile,file_stamp,journal_length);
+	} else if (journal_deltas == 0) {
+		journal->reset(currentFile,file_stamp);
+	}
+
 	//Find the "document" object, or create it
 	document = 0;
 	for (int i = 0; i < root_object->getChildrenCount(); i++) {
-		if (root_object->getChild(i)->getType() == "metadata") {
+		if (root_object->getChild(i)->getTypeId() == EVDS::Object::TYPE_METADATA) {
 			document = root_object->getChild(i);
 			root_object->hideChild(i);
 		}
@@ -301,13 +440,52 @@ bool EditorWindow::loadFile(const QString &fileName) {
 		document->setName("");
 	}
 
-	//Return control
+	//Return control, start generating meshes
+	EVDSEditor->getResidencyManager()->setDeferMeshes(false);
+	editorsWidget->setEnabled(true);
 	QApplication::restoreOverrideCursor();
 
 	//Finish initializing
 	EVDSEditor->finishInitializing();
 	SchematicsEditor->finishInitializing();
-	return true;
+
+	//Changes read from journal are kept by writing the entire file if journal is not used
+	if ((!useJournal) && (journal_deltas > 0)) setModified();
+
+	//Changes from a damaged journal can only be kept by writing the entire file
+	if (journal_deltas < 0) {
+		setModified();
+		if (fw_editor_flags & FOXWORKS_EDITOR_HEADLESS) {
+			qWarning("Journal of file %s is damaged, some of the saved changes were not applied",
+				currentFile.toUtf8().data());
+			return;
+		}
+		QMessageBox::warning(this, tr("FoxWorks Editor"),
+							 tr("Journal of file %1 is damaged.\nSome of the saved changes were not applied.")
+							 .arg(QFileInfo(currentFile).fileName()));
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::updateLoadingProgress() {
+	if (!loader) return;
+	statusBar()->showMessage(tr("Reading file... (%1 objects)").arg(loader->getLoadedObjects()));
+}
+
+void EditorWindow::meshQueueProgress(int done, int total) {
+	if (done >= total) {
+		statusBar()->clearMessage();
+		statusBar()->hide();
+		return;
+	}
+
+	loadingProgress->setRange(0,total);
+	loadingProgress->setValue(done);
+	statusBar()->showMessage(tr("Generating meshes... (%1 of %2)").arg(done).arg(total));
+	statusBar()->show();
 }
 
 
@@ -315,13 +493,37 @@ bool EditorWindow::loadFile(const QString &fileName) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 bool EditorWindow::saveFile(const QString &fileName, bool autoSave) {
+	if (loader) return false; //File is still being read
+	bool useJournal = fw_editor_settings->value("ui.journal_saves").toBool();
+
+	//Only append changes to journal of the file if possible
+	if ((!autoSave) && useJournal && journal->canAppend(fileName) && journal->append()) {
+		isModified = false;
+		updateTitle();
+		if (journal->needsCompaction()) startCompaction(fileName);
+		return true;
+	}
+
+	//File must not be written by the background thread at the same time
+	if (saver) {
+		saver->wait();
+		saverFinished();
+	}
+
 	//Save the file itself
-	EVDS_OBJECT_SAVEEX info = { 0 };
-	info.flags = EVDS_OBJECT_SAVEEX_ONLY_CHILDREN;
-	EVDS_Object_SaveEx(root,fileName.toUtf8().data(),&info);
+	if (!FileSaver::saveDocument(root,fileName)) {
+		if (!(fw_editor_flags & FOXWORKS_EDITOR_HEADLESS)) {
+			QMessageBox::warning(this, tr("FoxWorks Editor"),
+								 tr("Cannot write file %1.")
+								 .arg(fileName));
+		}
+		return false;
+	}
 
-	//If not auto-saving, remove modified flag
+	//If not auto-saving, start a new journal and remove modified flag
 	if (!autoSave) {
+		journal->reset(fileName,useJournal ? Journal::getFileStamp(fileName) : QByteArray());
+		documentCreated = false;
 		isModified = false;
 		currentFile = fileName;
 		updateTitle();
@@ -409,10 +611,61 @@ bool EditorWindow::save() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void EditorWindow::autoSave() {
-	if (currentFile != "") {
-		saveFile("_auto_" + QFileInfo(currentFile).fileName(),true);
-		mainWindow->statusBar()->showMessage(tr("Autosaved..."), 2000);
+	if (currentFile == "") return;
+	if (loader || saver) return; //File is still being read or previous autosave is being written
+	if (!autoSaveNeeded) return;
+
+	//Take a copy of the document, it is written out in background
+	EVDS_OBJECT* inertial_root;
+	EVDS_OBJECT* snapshot;
+	EVDS_System_GetRootInertialSpace(system,&inertial_root);
+	if (EVDS_Object_Copy(root,inertial_root,&snapshot) != EVDS_OK) return;
+	autoSaveNeeded = false;
+
+	saver = new FileSaver(snapshot,"_auto_" + QFileInfo(currentFile).fileName());
+	connect(saver, SIGNAL(finished()), this, SLOT(saverFinished()));
+	saver->start(QThread::LowPriority);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Merge journal into the file in background. Changes saved meanwhile are
+///  appended to the journal as usual.
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::startCompaction(const QString& fileName) {
+	if (saver) return; //Autosave is being written, compact after the next save
+	if (!journal->compactionStarted()) return;
+
+	EVDS_OBJECT* inertial_root;
+	EVDS_OBJECT* snapshot;
+	EVDS_System_GetRootInertialSpace(system,&inertial_root);
+	if (EVDS_Object_Copy(root,inertial_root,&snapshot) != EVDS_OK) return;
+
+	compacting = true;
+	saver = new FileSaver(snapshot,fileName,journal);
+	connect(saver, SIGNAL(finished()), this, SLOT(saverFinished()));
+	saver->start(QThread::LowPriority);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::saverFinished() {
+	if (!saver) return; //Already handled
+
+	if (compacting) {
+		journal->compactionFinished(saver->getResult());
+		if (!saver->getResult()) {
+			qWarning("EditorWindow::saverFinished: cannot compact %s",saver->getFileName().toUtf8().data());
+		}
+		compacting = false;
+	} else if (!saver->getResult()) {
+		qWarning("EditorWindow::saverFinished: cannot write %s",saver->getFileName().toUtf8().data());
+		autoSaveNeeded = true;
 	}
+	saver->deleteLater();
+	saver = 0;
 }
 
 
@@ -420,14 +673,20 @@ void EditorWindow::autoSave() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 bool EditorWindow::saveAs() {
+	QString binaryFilter = "External Vessel Dynamics Simulator Binary Model (*.evdsb)";
+	QString selectedFilter;
 	QString fileName = QFileDialog::getSaveFileName(this, "Save As", currentFile,
 		//"FoxWorks Data Files (*.evds *.ivss);;"
 		//"External Vessel Dynamics Simulator (*.evds);;"
 		//"Internal Vessel Systems Simulator (*.ivss);;"
-		"External Vessel Dynamics Simulator Model (*.evds);;"
-		"All files (*.*)");
+		"External Vessel Dynamics Simulator Model (*.evds);;" +
+		binaryFilter + ";;"
+		"All files (*.*)", &selectedFilter);
 
 	if (fileName.isEmpty())	return false;
+	if ((selectedFilter == binaryFilter) && (!FileSaver::isBinaryFileName(fileName))) {
+		fileName += ".evdsb";
+	}
 	return saveFile(fileName);
 }
 
@@ -436,7 +695,7 @@ bool EditorWindow::saveAs() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 bool EditorWindow::trySave() {
-	if (isModified) {
+	if (isModified && (!(fw_editor_flags & FOXWORKS_EDITOR_HEADLESS))) {
 		QMessageBox::StandardButton ret;
 		QString fileName = QFileInfo(currentFile).fileName();
 		if (currentFile == "") fileName = "New vessel";
@@ -488,10 +747,76 @@ void EditorWindow::updateTitle() {
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::setModified(EVDS::Object* object) {
+	isModified = true;
+	autoSaveNeeded = true;
+	journalCreatedDocument();
+	journal->objectChanged(object);
+	if (EVDSEditor && EVDSEditor->getInitializer()) EVDSEditor->getInitializer()->objectChanged(object);
+	updateTitle();
+}
+
+void EditorWindow::objectInserted(EVDS::Object* object) {
+	isModified = true;
+	autoSaveNeeded = true;
+	journalCreatedDocument();
+	journal->objectInserted(object);
+	if (EVDSEditor && EVDSEditor->getInitializer()) EVDSEditor->getInitializer()->structureChanged();
+	if (!isBatchUpdate()) updateTitle();
+}
+
+void EditorWindow::objectRemoved(EVDS::Object* object) {
+	isModified = true;
+	autoSaveNeeded = true;
+	journalCreatedDocument();
+	journal->objectRemoved(object);
+	if (EVDSEditor && EVDSEditor->getInitializer()) EVDSEditor->getInitializer()->structureChanged();
+	if (!isBatchUpdate()) updateTitle();
+}
+
+void EditorWindow::journalCreatedDocument() {
+	if (!documentCreated) return;
+	documentCreated = false;
+	journal->objectInserted(document);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Update everything that was skipped while objects were inserted or removed
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::endBatchUpdate() {
+	batchUpdates--;
+	if (batchUpdates > 0) return;
+
+	EVDSEditor->getModifiersManager()->updateModifiers();
+	SchematicsEditor->getSchematicsRenderingManager()->updateInstances();
+	updateObject(NULL);
+	updateTitle();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create children of a collapsed object, their meshes are generated later
+////////////////////////////////////////////////////////////////////////////////
+void EditorWindow::createChildren(EVDS::Object* object) {
+	if (!object->isCollapsed()) return;
+
+	emit childrenAboutToBeCreated(object,object->getCollapsedChildrenCount());
+	EVDSEditor->getResidencyManager()->setDeferMeshes(true);
+	object->createChildren();
+	EVDSEditor->getResidencyManager()->setDeferMeshes(false);
+	emit childrenCreated(object);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void EditorWindow::cut() {
+	if (EVDSEditor->getActive()) EVDSEditor->cut();
 }
 
 
@@ -499,6 +824,7 @@ void EditorWindow::cut() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void EditorWindow::copy() {
+	if (EVDSEditor->getActive()) EVDSEditor->copy();
 }
 
 
@@ -506,6 +832,7 @@ void EditorWindow::copy() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void EditorWindow::paste() {
+	if (EVDSEditor->getActive()) EVDSEditor->paste();
 }
 
 
@@ -23,6 +23,7 @@
 #include <QHash>
 #include <QMap>
 #include <QSemaphore>
+#include <QTimer>
 
 #include "evds.h"
 #include "evds_antenna.h"
@@ -32,6 +33,7 @@ QT_BEGIN_NAMESPACE
 class QWidget;
 class QStackedLayout;
 class QAction;
+class QProgressBar;
 QT_END_NAMESPACE
 
 
@@ -44,6 +46,9 @@ namespace EVDS {
 namespace FWE {
 	class MainWindow;
 	class EditorWindow;
+	class FileLoader;
+	class FileSaver;
+	class Journal;
 	class Editor : public QMainWindow {
 		Q_OBJECT
 
@@ -82,6 +87,19 @@ namespace FWE {
 		void newFile();
 		bool saveFile(const QString &fileName, bool autoSave = false);
 		bool loadFile(const QString &fileName);
+		//Is file still being read (objects are created once it's read)
+		bool isLoading() { return loader != 0; }
+		//Could file not be read (editor closes itself in that case)
+		bool isLoadingFailed() { return loadingFailed; }
+		//Are objects deep in the hierarchy created only when needed (for large files)
+		bool isLazyLoading() { return lazyLoading; }
+		//Create children of a collapsed object
+		void createChildren(EVDS::Object* object);
+		//Group insertions and removals of many objects. Modifiers, schematics and views
+		// are updated once, when the outermost group ends
+		void beginBatchUpdate() { batchUpdates++; }
+		void endBatchUpdate();
+		bool isBatchUpdate() { return batchUpdates > 0; }
 
 		//Shorthands for working with the current file
 		QString getCurrentFile() { return currentFile; }
@@ -105,6 +123,11 @@ namespace FWE {
 		QMap<QString,QList<QMap<QString,QString> > > objectVariables;
 		QMap<QString,QList<QMap<QString,QString> > > csectionVariables;
 
+	signals:
+		//Children of a collapsed object are about to be created, or were created
+		void childrenAboutToBeCreated(EVDS::Object* object, int count);
+		void childrenCreated(EVDS::Object* object);
+
 	protected:
 		void closeEvent(QCloseEvent *event);
 
@@ -117,15 +140,26 @@ namespace FWE {
 		void copy();
 		void paste();
 
-		//Set global project modified flag
-		void setModified() { isModified = true; updateTitle(); }
+		//Set global project modified flag (remembers which object was changed for journal)
+		void setModified(EVDS::Object* object = 0);
+		//Object was inserted, or is about to be removed from the tree
+		void objectInserted(EVDS::Object* object);
+		void objectRemoved(EVDS::Object* object);
 
 		//Keep-tracker for the number of active threads
 		void threadStarted() { activeThreads.release(1); }
 		void threadEnded() { activeThreads.acquire(1); }
+		int getActiveThreads() { return activeThreads.available(); }
 
 	private slots:
 		void cleanupTimer();
+		//File was read by the loader thread, create objects for it
+		void fileLoaded();
+		//Show progress of reading file and generating meshes
+		void updateLoadingProgress();
+		void meshQueueProgress(int done, int total);
+		//Snapshot was written by the autosave or journal compaction thread
+		void saverFinished();
 
 	private:
 		QSemaphore activeThreads;
@@ -139,6 +173,26 @@ namespace FWE {
 		//Current opened file
 		QString currentFile;
 		void updateTitle();
+		void showReadError();
+
+		//Background loading of the file
+		FileLoader* loader;
+		bool loadingFailed;
+		bool lazyLoading;
+		int batchUpdates;
+		QTimer loadingTimer;
+		QProgressBar* loadingProgress;
+
+		//Background autosave of the file
+		FileSaver* saver;
+		bool autoSaveNeeded;
+
+		//Journal of changes saved since the file was last fully written
+		Journal* journal;
+		bool compacting;
+		bool documentCreated; //Metadata was created for the file, but not journaled yet
+		void journalCreatedDocument();
+		void startCompaction(const QString& fileName);
 
 		//Editors
 		EVDS::Editor* EVDSEditor;
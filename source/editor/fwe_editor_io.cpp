@@ -0,0 +1,248 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QFile>
+#include "fwe_editor_io.h"
+#include "fwe_editor_journal.h"
+#include "fwe_evds_binary.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+using namespace FWE;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Callbacks from EVDS loader (called in the loader thread)
+////////////////////////////////////////////////////////////////////////////////
+int FWE_FileLoader_OnLoadObject(EVDS_OBJECT_LOADEX* info, EVDS_OBJECT* object) {
+	FileLoader* loader = (FileLoader*)info->userdata;
+	loader->objectLoaded();
+	return EVDS_OK;
+}
+
+int FWE_FileLoader_OnSyntaxError(EVDS_OBJECT_LOADEX* info, const char* error) {
+	FileLoader* loader = (FileLoader*)info->userdata;
+	loader->syntaxError(QString(error));
+	return EVDS_OK;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reads EVDS file in a separate thread.
+///
+/// Only EVDS data structures are created by the loader. The file is read into
+/// a detached object owned by the loader thread; its children are moved into
+/// the root object and editor objects are created once the thread has finished.
+////////////////////////////////////////////////////////////////////////////////
+FileLoader::FileLoader(EVDS_OBJECT* in_root, const QString& in_fileName, bool in_useJournal) : loadedObjects(0) {
+	root = in_root;
+	loaded = 0;
+	fileName = in_fileName;
+	useJournal = in_useJournal;
+	errorCode = EVDS_OK;
+	journalDeltas = 0;
+	journalLength = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+FileLoader::~FileLoader() {
+	EVDS_OBJECT* object = takeLoadedObject();
+	if (object) EVDS_Object_Destroy(object);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+EVDS_OBJECT* FileLoader::takeLoadedObject() {
+	EVDS_OBJECT* object = loaded;
+	loaded = 0;
+	if (object) EVDS_Object_TransferInitialization(object); //Get rights to work with variables
+	return object;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QString FileLoader::getSyntaxError() {
+	QMutexLocker locker(&syntaxErrorLock);
+	return syntaxErrorMessage;
+}
+
+void FileLoader::syntaxError(const QString& message) {
+	QMutexLocker locker(&syntaxErrorLock);
+	syntaxErrorMessage = message;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void FileLoader::run() {
+	EVDS_OBJECT_LOADEX info = { 0 };
+	info.OnLoadObject = &FWE_FileLoader_OnLoadObject;
+	info.OnSyntaxError = &FWE_FileLoader_OnSyntaxError;
+	info.userdata = (void*)this;
+
+	//Objects are created in this thread, so they are read into an object owned by it
+	EVDS_OBJECT* inertial_root;
+	EVDS_SYSTEM* system;
+	EVDS_Object_GetSystem(root,&system);
+	EVDS_System_GetRootInertialSpace(system,&inertial_root);
+	EVDS_Object_Create(inertial_root,&loaded);
+
+	//Binary documents are decoded and loaded one top-level object at a time, so
+	// only a single section is kept as XML description
+	if (EVDS::BinaryDocument::isBinaryFile(fileName)) {
+		EVDS::BinaryDocument document;
+		if (!document.read(fileName)) {
+			syntaxError("damaged binary document");
+			errorCode = EVDS_ERROR_SYNTAX;
+			return;
+		}
+
+		errorCode = EVDS_OK;
+		for (int i = 0; (i < document.getSectionCount()) && (errorCode == EVDS_OK); i++) {
+			QByteArray description = document.toXML(i);
+			if (description.isEmpty()) {
+				syntaxError("damaged binary document");
+				errorCode = EVDS_ERROR_SYNTAX;
+				return;
+			}
+
+			info.description = description.data();
+			errorCode = EVDS_Object_LoadEx(loaded,0,&info);
+		}
+	} else {
+		errorCode = EVDS_Object_LoadEx(loaded,fileName.toUtf8().data(),&info);
+	}
+
+	//Apply changes saved into journal of the file. File is only hashed if journal is used,
+	// or if changes were journaled before journaled saves were turned off
+	if ((!useJournal) &&
+		(!QFile::exists(Journal::getJournalFileName(fileName))) &&
+		(!QFile::exists(Journal::getNextJournalFileName(fileName)))) {
+		return;
+	}
+	if (errorCode == EVDS_OK) {
+		fileStamp = Journal::getFileStamp(fileName);
+		journalDeltas = Journal::replay(loaded,fileName,fileStamp,&journalLength);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Writes snapshot of the document in a separate thread.
+///
+/// The snapshot is written into a temporary file first, which then replaces the
+/// target file. The target is never left partially written.
+////////////////////////////////////////////////////////////////////////////////
+FileSaver::FileSaver(EVDS_OBJECT* in_snapshot, const QString& in_fileName, Journal* in_journal) {
+	snapshot = in_snapshot;
+	fileName = in_fileName;
+	result = false;
+	journal = in_journal;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void FileSaver::run() {
+	//Snapshot was copied by the GUI thread, take it over before reading it
+	EVDS_Object_TransferInitialization(snapshot);
+	if (journal) {
+		//Journal is rebased on the written snapshot before it replaces the file
+		QString tempFileName = fileName + ".tmp";
+		result = writeDocument(snapshot,fileName,tempFileName) &&
+				 journal->compact(tempFileName,Journal::getFileStamp(tempFileName));
+		if (!result) QFile::remove(tempFileName);
+	} else {
+		result = saveDocument(snapshot,fileName);
+	}
+	EVDS_Object_Destroy(snapshot);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write children of the root object into temporary file, then replace
+///  the target file with it.
+////////////////////////////////////////////////////////////////////////////////
+bool FileSaver::saveDocument(EVDS_OBJECT* root, const QString& fileName) {
+	QString tempFileName = fileName + ".tmp";
+	bool result = writeDocument(root,fileName,tempFileName);
+	if (result) result = replaceFile(tempFileName,fileName);
+	if (!result) QFile::remove(tempFileName);
+	return result;
+}
+
+bool FileSaver::writeDocument(EVDS_OBJECT* root, const QString& fileName, const QString& tempFileName) {
+	bool result;
+
+	EVDS_OBJECT_SAVEEX info = { 0 };
+	info.flags = EVDS_OBJECT_SAVEEX_ONLY_CHILDREN;
+	if (isBinaryFileName(fileName)) {
+		result = EVDS_Object_SaveEx(root,0,&info) == EVDS_OK;
+		if (result) {
+			EVDS::BinaryDocument document;
+			result = document.fromXML(QByteArray(info.description)) && document.write(tempFileName);
+		}
+		if (info.description) free(info.description);
+	} else {
+		result = EVDS_Object_SaveEx(root,tempFileName.toUtf8().data(),&info) == EVDS_OK;
+	}
+
+	//File must be on disk before it replaces anything
+	if (result) {
+		QFile file(tempFileName);
+		result = file.open(QIODevice::ReadWrite) && syncFile(&file);
+	}
+	return result;
+}
+
+bool FileSaver::isBinaryFileName(const QString& fileName) {
+	return fileName.endsWith(".evdsb",Qt::CaseInsensitive);
+}
+
+bool FileSaver::syncFile(QFile* file) {
+	if (!file->flush()) return false;
+#ifdef Q_OS_WIN
+	return _commit(file->handle()) == 0;
+#else
+	return fsync(file->handle()) == 0;
+#endif
+}
+
+bool FileSaver::replaceFile(const QString& source, const QString& target) {
+#ifdef Q_OS_WIN
+	return MoveFileExW((LPCWSTR)source.utf16(),(LPCWSTR)target.utf16(),
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(QFile::encodeName(source).data(),QFile::encodeName(target).data()) == 0;
+#endif
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EDITOR_IO_H
+#define FWE_EDITOR_IO_H
+
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "evds.h"
+
+QT_BEGIN_NAMESPACE
+class QFile;
+QT_END_NAMESPACE
+
+
+////////////////////////////////////////////////////////////////////////////////
+namespace FWE {
+	class Journal;
+	class FileLoader : public QThread {
+		Q_OBJECT
+
+	public:
+		//Journal of the file is only read if journaled saves are used (or if it exists)
+		FileLoader(EVDS_OBJECT* in_root, const QString& in_fileName, bool in_useJournal);
+		~FileLoader();
+
+		//Take object which holds the loaded children (valid after thread has finished).
+		// It belongs to the calling thread and must be destroyed by it
+		EVDS_OBJECT* takeLoadedObject();
+
+		//Result of reading the file (valid after thread has finished)
+		int getErrorCode() { return errorCode; }
+		QString getSyntaxError();
+		//Number of objects read so far
+		int getLoadedObjects() { return loadedObjects; }
+		//Checksum of the file, number of journal deltas applied (-1 if journal is damaged)
+		QByteArray getFileStamp() { return fileStamp; }
+		int getJournalDeltas() { return journalDeltas; }
+		qint64 getJournalLength() { return journalLength; }
+
+		//Called from EVDS loader callbacks
+		void objectLoaded() { loadedObjects.ref(); }
+		void syntaxError(const QString& message);
+
+	protected:
+		void run();
+
+	private:
+		EVDS_OBJECT* root; //Object into which file will be moved
+		EVDS_OBJECT* loaded; //Object created by the loader thread, into which file is read
+		QString fileName;
+		bool useJournal;
+		int errorCode;
+		QByteArray fileStamp;
+		int journalDeltas;
+		qint64 journalLength;
+
+		QAtomicInt loadedObjects;
+		QMutex syntaxErrorLock;
+		QString syntaxErrorMessage;
+	};
+
+
+	class FileSaver : public QThread {
+		Q_OBJECT
+
+	public:
+		//If journal is given, snapshot is a compaction of it: journal replaces the file
+		FileSaver(EVDS_OBJECT* in_snapshot, const QString& in_fileName, Journal* in_journal = 0);
+
+		//Was file written successfully (valid after thread has finished)
+		bool getResult() { return result; }
+		QString getFileName() { return fileName; }
+
+		//Write document into file (binary format is chosen by file extension)
+		static bool saveDocument(EVDS_OBJECT* root, const QString& fileName);
+		//Write document for the given file into a temporary file and make sure it has reached the disk
+		static bool writeDocument(EVDS_OBJECT* root, const QString& fileName, const QString& tempFileName);
+		//Flush file and make sure data written into it has reached the disk
+		static bool syncFile(QFile* file);
+		//Should the file be written in binary format
+		static bool isBinaryFileName(const QString& fileName);
+		//Replace target file with source file in a single step
+		static bool replaceFile(const QString& source, const QString& target);
+
+	protected:
+		void run();
+
+	private:
+		EVDS_OBJECT* snapshot; //Copy of the document (destroyed after saving)
+		QString fileName;
+		bool result;
+		Journal* journal;
+	};
+}
+
+#endif
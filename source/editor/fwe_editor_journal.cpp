@@ -0,0 +1,624 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include "fwe_editor_journal.h"
+#include "fwe_editor_io.h"
+#include "fwe_evds_object.h"
+
+using namespace FWE;
+
+//File signature and version
+#define FWE_JOURNAL_MAGIC				"EVDJ"
+#define FWE_JOURNAL_VERSION				1
+//Size of the journal header (signature, version, checksum of the file)
+#define FWE_JOURNAL_HEADER_SIZE			24
+//Size of the delta header (length and checksum)
+#define FWE_JOURNAL_DELTA_HEADER_SIZE	6
+//Types of records
+#define FWE_JOURNAL_RECORD_INSERT		1
+#define FWE_JOURNAL_RECORD_REMOVE		2
+#define FWE_JOURNAL_RECORD_REPLACE		3 //Replaces object with its children (older journals)
+#define FWE_JOURNAL_RECORD_UPDATE		4 //Replaces object, keeping its children
+//Journal is never compacted while it's smaller than this
+#define FWE_JOURNAL_COMPACT_SIZE		(256*1024)
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Helpers for working with EVDS lists of children
+////////////////////////////////////////////////////////////////////////////////
+static int FWE_Journal_GetChildIndex(EVDS_OBJECT* parent, EVDS_OBJECT* child) {
+	int idx = 0;
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+
+	EVDS_Object_GetAllChildren(parent,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		if ((EVDS_OBJECT*)SIMC_List_GetData(list,entry) == child) {
+			SIMC_List_Stop(list,entry);
+			return idx;
+		}
+		idx++;
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	return -1;
+}
+
+static EVDS_OBJECT* FWE_Journal_GetChild(EVDS_OBJECT* parent, quint32 index) {
+	quint32 idx = 0;
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+
+	EVDS_Object_GetAllChildren(parent,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		if (idx == index) {
+			EVDS_OBJECT* child = (EVDS_OBJECT*)SIMC_List_GetData(list,entry);
+			SIMC_List_Stop(list,entry);
+			return child;
+		}
+		idx++;
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Load object from description and move it into the given position
+////////////////////////////////////////////////////////////////////////////////
+static bool FWE_Journal_InsertObject(EVDS_OBJECT* parent, quint32 index, QByteArray description) {
+	EVDS_OBJECT_LOADEX info = { 0 };
+	info.flags = EVDS_OBJECT_LOADEX_ONLY_FIRST;
+	info.description = description.data();
+	if (EVDS_Object_LoadEx(parent,0,&info) != EVDS_OK) return false;
+	if (!info.firstObject) return false;
+
+	//Find head for this object
+	quint32 idx = 0;
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+	EVDS_OBJECT* head = 0;
+
+	EVDS_Object_GetAllChildren(parent,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		if (idx == index) break;
+		head = (EVDS_OBJECT*)SIMC_List_GetData(list,entry);
+
+		idx++;
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	SIMC_List_Stop(list,entry);
+
+	//Move object into correct position in EVDS internal list
+	if (entry) EVDS_Object_MoveInList(info.firstObject,head);
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Replace object with the one from description, children of the old object
+///  are moved into the new one
+////////////////////////////////////////////////////////////////////////////////
+static bool FWE_Journal_UpdateObject(EVDS_OBJECT* parent, quint32 index, QByteArray description) {
+	EVDS_OBJECT* old_object = FWE_Journal_GetChild(parent,index);
+	if (!old_object) return false;
+
+	//New object is placed in front of the old one
+	if (!FWE_Journal_InsertObject(parent,index,description)) return false;
+	EVDS_OBJECT* new_object = FWE_Journal_GetChild(parent,index);
+	if ((!new_object) || (new_object == old_object)) return false;
+
+	QList<EVDS_OBJECT*> children;
+	SIMC_LIST* list;
+	SIMC_LIST_ENTRY* entry;
+	EVDS_Object_GetAllChildren(old_object,&list);
+	entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		children.append((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	for (int i = 0; i < children.count(); i++) {
+		EVDS_Object_SetParent(children[i],new_object);
+	}
+
+	EVDS_Object_Destroy(old_object);
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get description of the object (with all of its children)
+////////////////////////////////////////////////////////////////////////////////
+static QByteArray FWE_Journal_SaveObject(EVDS_OBJECT* object) {
+	QByteArray description;
+	EVDS_OBJECT_SAVEEX info = { 0 };
+	if (EVDS_Object_SaveEx(object,0,&info) == EVDS_OK) description = QByteArray(info.description);
+	if (info.description) free(info.description);
+	return description;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get description of the object alone (children are left out)
+////////////////////////////////////////////////////////////////////////////////
+static QByteArray FWE_Journal_SaveSingleObject(EVDS_OBJECT* object) {
+	EVDS_SYSTEM* system;
+	EVDS_OBJECT* inertial_root;
+	EVDS_OBJECT* copy;
+	EVDS_Object_GetSystem(object,&system);
+	EVDS_System_GetRootInertialSpace(system,&inertial_root);
+	if (EVDS_Object_CopySingle(object,inertial_root,&copy) != EVDS_OK) return QByteArray();
+
+	QByteArray description = FWE_Journal_SaveObject(copy);
+	EVDS_Object_Destroy(copy);
+	return description;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check if journal was written against file with the given checksum
+////////////////////////////////////////////////////////////////////////////////
+static bool FWE_Journal_HasStamp(const QString& journalFileName, const QByteArray& stamp) {
+	if (stamp.isEmpty()) return false;
+	QFile file(journalFileName);
+	if (!file.open(QIODevice::ReadOnly)) return false;
+
+	QByteArray header = file.read(FWE_JOURNAL_HEADER_SIZE);
+	return (header.size() == FWE_JOURNAL_HEADER_SIZE) &&
+		   (memcmp(header.constData(),FWE_JOURNAL_MAGIC,4) == 0) &&
+		   (header.mid(8,stamp.size()) == stamp);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Apply a single delta to the document
+////////////////////////////////////////////////////////////////////////////////
+static bool FWE_Journal_ApplyDelta(EVDS_OBJECT* root, const uchar* ptr, const uchar* end) {
+	while (ptr < end) {
+		//Record type and path to the object
+		if (end - ptr < 5) return false;
+		int type = *ptr;
+		quint32 count = qFromLittleEndian<quint32>(ptr+1);
+		ptr += 5;
+		if ((count == 0) || ((quint64)(end - ptr) < (quint64)count*4 + 4)) return false;
+
+		EVDS_OBJECT* parent = root;
+		for (quint32 i = 0; i < count-1; i++) {
+			parent = FWE_Journal_GetChild(parent,qFromLittleEndian<quint32>(ptr+i*4));
+			if (!parent) return false;
+		}
+		quint32 index = qFromLittleEndian<quint32>(ptr+(count-1)*4);
+		ptr += count*4;
+
+		//Description of the object
+		quint32 length = qFromLittleEndian<quint32>(ptr);
+		ptr += 4;
+		if ((quint64)(end - ptr) < length) return false;
+		QByteArray description((const char*)ptr,length);
+		ptr += length;
+
+		//Apply the change
+		EVDS_OBJECT* object;
+		switch (type) {
+			case FWE_JOURNAL_RECORD_INSERT:
+				if (!FWE_Journal_InsertObject(parent,index,description)) return false;
+				break;
+			case FWE_JOURNAL_RECORD_REMOVE:
+				object = FWE_Journal_GetChild(parent,index);
+				if (!object) return false;
+				EVDS_Object_Destroy(object);
+				break;
+			case FWE_JOURNAL_RECORD_REPLACE:
+				object = FWE_Journal_GetChild(parent,index);
+				if (!object) return false;
+				EVDS_Object_Destroy(object);
+				if (!FWE_Journal_InsertObject(parent,index,description)) return false;
+				break;
+			case FWE_JOURNAL_RECORD_UPDATE:
+				if (!FWE_Journal_UpdateObject(parent,index,description)) return false;
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Journal of changes since the document was last fully written.
+///
+/// File layout (all numbers are little-endian):
+///  - Header: signature, version, checksum of the file the journal applies to
+///  - Deltas: length, checksum of the contents, records
+///
+/// Every record is type, path to the object (indices in lists of children) and
+/// description of the object. Inserted objects are written with their children,
+/// changed objects are written alone and keep children of the previous version.
+/// A delta which was not written completely is ignored when reading the journal.
+////////////////////////////////////////////////////////////////////////////////
+Journal::Journal(EVDS::Object* in_root) {
+	root = in_root;
+	baseSize = 0;
+	length = 0;
+	compactionOffset = 0;
+	valid = false;
+	damaged = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Journal::reset(const QString& in_fileName, const QByteArray& stamp) {
+	invalidate();
+	QFile::remove(getJournalFileName(in_fileName));
+	QFile::remove(getNextJournalFileName(in_fileName));
+	if (stamp.isEmpty()) return; //Journal is not used for this file
+
+	QMutexLocker locker(&lock);
+	fileName = in_fileName;
+	baseStamp = stamp;
+	baseSize = QFileInfo(fileName).size();
+	length = 0;
+	damaged = false;
+	valid = true;
+}
+
+void Journal::resume(const QString& in_fileName, const QByteArray& stamp, qint64 in_length) {
+	invalidate();
+	if (stamp.isEmpty()) return;
+
+	QMutexLocker locker(&lock);
+	fileName = in_fileName;
+	baseStamp = stamp;
+	baseSize = QFileInfo(fileName).size();
+	length = in_length;
+	damaged = false;
+	valid = true;
+}
+
+void Journal::invalidate() {
+	valid = false;
+	records.clear();
+	changedObjects.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool Journal::canAppend(const QString& in_fileName) {
+	return valid && (fileName == in_fileName) && QFile::exists(fileName);
+}
+
+bool Journal::needsCompaction() {
+	QMutexLocker locker(&lock);
+	return valid && (length > FWE_JOURNAL_COMPACT_SIZE) && (length > baseSize/2);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool Journal::getPath(EVDS::Object* object, QList<quint32>* path) {
+	path->clear();
+	while (object != root) {
+		EVDS::Object* parent = object->getParent();
+		if (!parent) return false;
+
+		int index = FWE_Journal_GetChildIndex(parent->getEVDSObject(),object->getEVDSObject());
+		if (index < 0) return false;
+		path->prepend(index);
+		object = parent;
+	}
+	return true;
+}
+
+void Journal::addRecord(int type, const QList<quint32>& path, const QByteArray& description) {
+	uchar number[4];
+	records.append((char)type);
+	qToLittleEndian<quint32>(path.count(),number);
+	records.append((const char*)number,4);
+	for (int i = 0; i < path.count(); i++) {
+		qToLittleEndian<quint32>(path[i],number);
+		records.append((const char*)number,4);
+	}
+	qToLittleEndian<quint32>(description.size(),number);
+	records.append((const char*)number,4);
+	records.append(description);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Remember changed object. Changes to the root object (or changes which
+///  are not tied to an object) require writing the entire document.
+////////////////////////////////////////////////////////////////////////////////
+void Journal::objectChanged(EVDS::Object* object) {
+	if (!valid) return;
+	if ((!object) || (object == root)) {
+		invalidate();
+		return;
+	}
+	changedObjects[object] = object;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Record object which was just inserted into the tree
+////////////////////////////////////////////////////////////////////////////////
+void Journal::objectInserted(EVDS::Object* object) {
+	if (!valid) return;
+
+	QList<quint32> path;
+	QByteArray description = FWE_Journal_SaveObject(object->getEVDSObject());
+	if (description.isEmpty() || (!getPath(object,&path)) || path.isEmpty()) {
+		invalidate();
+		return;
+	}
+	addRecord(FWE_JOURNAL_RECORD_INSERT,path,description);
+	changedObjects.remove(object);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Record object which is about to be removed from the tree
+////////////////////////////////////////////////////////////////////////////////
+void Journal::objectRemoved(EVDS::Object* object) {
+	if (!valid) return;
+
+	QList<quint32> path;
+	if ((!getPath(object,&path)) || path.isEmpty()) {
+		invalidate();
+		return;
+	}
+	addRecord(FWE_JOURNAL_RECORD_REMOVE,path,QByteArray());
+	changedObjects.remove(object);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write all changes as a single delta. Journal is invalidated if delta
+///  cannot be written, so the next save writes the entire document.
+////////////////////////////////////////////////////////////////////////////////
+bool Journal::append() {
+	if (!valid) return false;
+
+	//Changed objects are written alone, their children are only written if changed
+	QHash<EVDS::Object*,QPointer<EVDS::Object> >::iterator i;
+	for (i = changedObjects.begin(); i != changedObjects.end(); ++i) {
+		EVDS::Object* object = i.value();
+		if (!object) continue; //Was removed
+
+		QList<quint32> path;
+		QByteArray description = FWE_Journal_SaveSingleObject(object->getEVDSObject());
+		if (description.isEmpty() || (!getPath(object,&path)) || path.isEmpty()) {
+			invalidate();
+			return false;
+		}
+		addRecord(FWE_JOURNAL_RECORD_UPDATE,path,description);
+	}
+	changedObjects.clear();
+	if (records.isEmpty()) return true;
+
+	//Saver thread may be rebasing the journal on a compacted file
+	lock.lock();
+		bool result = !damaged;
+
+		//Open journal (header is written with the first delta)
+		QString journalFileName = getJournalFileName(fileName);
+		if (result && (length == 0)) {
+			result = writeHeader(journalFileName,baseStamp);
+			if (result) length = FWE_JOURNAL_HEADER_SIZE;
+		}
+		QFile file(journalFileName);
+		result = result && file.open(QIODevice::ReadWrite) && file.resize(length) && file.seek(length);
+
+		//Write delta
+		uchar header[FWE_JOURNAL_DELTA_HEADER_SIZE];
+		qToLittleEndian<quint32>(records.size(),header);
+		qToLittleEndian<quint16>(qChecksum(records.constData(),records.size()),header+4);
+		result = result &&
+			(file.write((const char*)header,FWE_JOURNAL_DELTA_HEADER_SIZE) == FWE_JOURNAL_DELTA_HEADER_SIZE) &&
+			(file.write(records) == records.size()) &&
+			FileSaver::syncFile(&file);
+		if (result) length += FWE_JOURNAL_DELTA_HEADER_SIZE + records.size();
+		file.close();
+	lock.unlock();
+
+	if (!result) {
+		invalidate();
+		return false;
+	}
+	records.clear();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool Journal::writeHeader(const QString& journalFileName, const QByteArray& stamp) {
+	QByteArray header(FWE_JOURNAL_HEADER_SIZE,0);
+	memcpy(header.data(),FWE_JOURNAL_MAGIC,4);
+	qToLittleEndian<quint32>(FWE_JOURNAL_VERSION,(uchar*)header.data()+4);
+	memcpy(header.data()+8,stamp.constData(),qMin(stamp.size(),FWE_JOURNAL_HEADER_SIZE-8));
+
+	QFile file(journalFileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+	return file.write(header) == header.size();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Flush pending changes before snapshot of the document is written out
+////////////////////////////////////////////////////////////////////////////////
+bool Journal::compactionStarted() {
+	if (!append()) return false;
+	QMutexLocker locker(&lock);
+	compactionOffset = length;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Replace the file with written snapshot (called by the saver thread).
+///
+/// Deltas appended after the snapshot was taken are written into the next journal
+/// against the new file before it replaces the old one. If compaction is stopped
+/// after the file was replaced but before its journal was, replay() uses the next
+/// journal, so changes are never lost.
+////////////////////////////////////////////////////////////////////////////////
+bool Journal::compact(const QString& tempFileName, const QByteArray& stamp) {
+	QMutexLocker locker(&lock);
+	if (damaged || stamp.isEmpty()) return false;
+	QString journalFileName = getJournalFileName(fileName);
+	QString nextFileName = getNextJournalFileName(fileName);
+
+	//Read deltas which were appended during compaction
+	QByteArray deltas;
+	if (length > compactionOffset) {
+		QFile file(journalFileName);
+		if ((!file.open(QIODevice::ReadOnly)) || (!file.seek(compactionOffset))) return false;
+		deltas = file.read(length - compactionOffset);
+		if (deltas.size() != length - compactionOffset) return false;
+	}
+
+	//Write next journal
+	if (!deltas.isEmpty()) {
+		bool result = writeHeader(nextFileName,stamp);
+		if (result) {
+			QFile file(nextFileName);
+			result = file.open(QIODevice::Append) && (file.write(deltas) == deltas.size()) && FileSaver::syncFile(&file);
+		}
+		if (!result) {
+			QFile::remove(nextFileName);
+			return false;
+		}
+	}
+
+	//Replace the file, then its journal
+	if (!FileSaver::replaceFile(tempFileName,fileName)) {
+		QFile::remove(nextFileName);
+		return false;
+	}
+	baseStamp = stamp;
+	baseSize = QFileInfo(fileName).size();
+	if (deltas.isEmpty()) {
+		QFile::remove(journalFileName);
+		length = 0;
+		return true;
+	}
+	if (!FileSaver::replaceFile(nextFileName,journalFileName)) {
+		damaged = true; //Journal file no longer matches the file
+		return false;
+	}
+	length = FWE_JOURNAL_HEADER_SIZE + deltas.size();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Next save writes the entire document if compaction has failed
+////////////////////////////////////////////////////////////////////////////////
+void Journal::compactionFinished(bool result) {
+	if (!result) invalidate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QString Journal::getJournalFileName(const QString& fileName) {
+	return fileName + ".journal";
+}
+
+QString Journal::getNextJournalFileName(const QString& fileName) {
+	return fileName + ".journal.next";
+}
+
+QByteArray Journal::getFileStamp(const QString& fileName) {
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	while (!file.atEnd()) {
+		QByteArray data = file.read(1024*1024);
+		if (data.isEmpty()) return QByteArray();
+		hash.addData(data);
+	}
+	return hash.result();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Apply deltas until the end of journal, or until an incomplete delta
+////////////////////////////////////////////////////////////////////////////////
+int Journal::replay(EVDS_OBJECT* root, const QString& fileName, const QByteArray& stamp, qint64* length) {
+	*length = 0;
+
+	//Finish compaction which was stopped after the file was replaced
+	QString nextFileName = getNextJournalFileName(fileName);
+	if (QFile::exists(nextFileName)) {
+		if (FWE_Journal_HasStamp(nextFileName,stamp)) {
+			if (!FileSaver::replaceFile(nextFileName,getJournalFileName(fileName))) return -1;
+		} else {
+			QFile::remove(nextFileName);
+		}
+	}
+
+	QFile file(getJournalFileName(fileName));
+	if (!file.exists()) return 0;
+	if (!file.open(QIODevice::ReadOnly)) return -1;
+
+	QByteArray journal = file.readAll();
+	const uchar* data = (const uchar*)journal.constData();
+	qint64 size = journal.size();
+	if ((size < FWE_JOURNAL_HEADER_SIZE) || (memcmp(data,FWE_JOURNAL_MAGIC,4) != 0) ||
+		(qFromLittleEndian<quint32>(data+4) != FWE_JOURNAL_VERSION)) {
+		return -1;
+	}
+
+	//Journal which was written for another version of the file is ignored
+	if (journal.mid(8,stamp.size()) != stamp) return 0;
+
+	int deltas = 0;
+	qint64 offset = FWE_JOURNAL_HEADER_SIZE;
+	while (offset + FWE_JOURNAL_DELTA_HEADER_SIZE <= size) {
+		quint32 deltaLength = qFromLittleEndian<quint32>(data+offset);
+		quint16 checksum = qFromLittleEndian<quint16>(data+offset+4);
+		const uchar* delta = data+offset+FWE_JOURNAL_DELTA_HEADER_SIZE;
+		if (deltaLength > size - offset - FWE_JOURNAL_DELTA_HEADER_SIZE) break;
+		if (qChecksum((const char*)delta,deltaLength) != checksum) break;
+
+		if (!FWE_Journal_ApplyDelta(root,delta,delta+deltaLength)) {
+			*length = offset;
+			return -1;
+		}
+		offset += FWE_JOURNAL_DELTA_HEADER_SIZE + deltaLength;
+		deltas++;
+	}
+	*length = offset;
+	return deltas;
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EDITOR_JOURNAL_H
+#define FWE_EDITOR_JOURNAL_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QMutex>
+
+#include "evds.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+namespace EVDS {
+	class Object;
+}
+namespace FWE {
+	//Append-only journal of changes made to the document since it was last fully
+	// written. Every save appends a single delta, which replaces changed objects
+	// and inserts or removes objects in the tree. During compaction the journal file
+	// is also written by the saver thread.
+	class Journal {
+	public:
+		Journal(EVDS::Object* in_root);
+
+		//Start a new journal for a file which was just fully written (or read)
+		void reset(const QString& fileName, const QByteArray& stamp);
+		//Continue journal which was replayed when reading the file
+		void resume(const QString& fileName, const QByteArray& stamp, qint64 length);
+		//Next save must write the entire document
+		void invalidate();
+
+		//Can changes be appended to journal of the given file
+		bool canAppend(const QString& fileName);
+		//Journal has grown large enough to be merged into the file
+		bool needsCompaction();
+
+		//Record changes (structural changes must be recorded as they happen)
+		void objectChanged(EVDS::Object* object);
+		void objectInserted(EVDS::Object* object);
+		void objectRemoved(EVDS::Object* object);
+
+		//Append all recorded changes as a single delta
+		bool append();
+
+		//Compaction: pending changes are flushed before document snapshot is taken. Saver
+		// thread rebases journal on the written snapshot and replaces the file with it
+		bool compactionStarted();
+		bool compact(const QString& tempFileName, const QByteArray& stamp);
+		void compactionFinished(bool result);
+
+		//Name of the journal file for a document, and of the journal written by compaction
+		static QString getJournalFileName(const QString& fileName);
+		static QString getNextJournalFileName(const QString& fileName);
+		//Checksum of the file contents which journal was written against
+		static QByteArray getFileStamp(const QString& fileName);
+		//Apply journal of the file to freshly read document. Returns number of deltas
+		// applied, or -1 if journal could not be applied completely
+		static int replay(EVDS_OBJECT* root, const QString& fileName, const QByteArray& stamp, qint64* length);
+
+	private:
+		//Find path to object (indices in EVDS lists of children). Empty for root
+		bool getPath(EVDS::Object* object, QList<quint32>* path);
+		//Add record to the pending delta
+		void addRecord(int type, const QList<quint32>& path, const QByteArray& description);
+		//Write journal header
+		static bool writeHeader(const QString& journalFileName, const QByteArray& stamp);
+
+		EVDS::Object* root;
+		QString fileName;
+		bool valid;
+
+		//Journal file state (shared with the saver thread during compaction)
+		QMutex lock;
+		QByteArray baseStamp;
+		qint64 baseSize;
+		qint64 length; //Length of valid journal data
+		qint64 compactionOffset; //Length of journal when compaction snapshot was taken
+		bool damaged; //Journal file no longer matches the document file
+
+		//Pending delta: structural changes in order, and objects which were changed
+		QByteArray records;
+		QHash<EVDS::Object*,QPointer<EVDS::Object> > changedObjects;
+	};
+}
+
+#endif
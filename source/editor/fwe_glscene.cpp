@@ -24,6 +24,7 @@
 #include <QHBoxLayout>
 #include <QFontMetrics>
 #include <QFileInfo>
+#include <QGLBuffer>
 
 #include <GLC_UserInput>
 #include <GLC_Exception>
@@ -38,9 +39,28 @@
 #include "fwe_glscene.h"
 #include "fwe_schematics.h"
 #include "fwe_schematics_renderer.h"
+#include "fwe_schematics_export.h"
+#include "fwe_trace.h"
 
 using namespace EVDS;
 
+//Interned variable names
+static const VariableRef var_sheet_code("sheet.code");
+static const VariableRef var_document_code("document.code");
+static const VariableRef var_sheet_number("sheet.number");
+static const VariableRef var_paper_ppcm("paper.ppcm");
+static const VariableRef var_reference("reference");
+static const VariableRef var_text("text");
+static const VariableRef var_paper_width_multiplier("paper.width_multiplier");
+static const VariableRef var_paper_height_multiplier("paper.height_multiplier");
+static const VariableRef var_document_created_by("document.created_by");
+static const VariableRef var_document_drawn_by("document.drawn_by");
+static const VariableRef var_document_verified_by("document.verified_by");
+static const VariableRef var_sheet_scale("sheet.scale");
+static const VariableRef var_sheet_title("sheet.title");
+static const VariableRef var_document_title("document.title");
+static const VariableRef var_document_company("document.company");
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
@@ -94,8 +114,19 @@ GLScene::GLScene(GLScene* in_parent_scene, Editor* in_editor, SchematicsEditor*
 	light[0]->setTwoSided(true);
 
 	//Setup signals
-	connect(viewport, SIGNAL(updateOpenGL()), this, SLOT(update())); //FIXME: use render() instead
-	connect(&controller, SIGNAL(repaintNeeded()), this, SLOT(update()));
+	connect(viewport, SIGNAL(updateOpenGL()), this, SLOT(requestRender()));
+	connect(&controller, SIGNAL(repaintNeeded()), this, SLOT(requestRender()));
+
+	//Setup render scheduling (scene is only redrawn when something has changed)
+	sceneGeneration = 1;
+	renderedGeneration = 0;
+	renderedOverlay = 0;
+	renderedSelection = 0;
+	renderedViewAngle = 0.0;
+	renderTimer.setSingleShot(true);
+	connect(&renderTimer, SIGNAL(timeout()), this, SLOT(update()));
+	lastFrameTime.start();
+	interactiveCulling = 2*qMax(1,fw_editor_settings->value("rendering.min_pixel_culling").toInt());
 
 	//Enable LOD, setup default camera
 	viewport->cameraHandle()->setDefaultUpVector(glc::Z_AXIS);
@@ -228,6 +259,7 @@ void GLScene::createInterface() {
 ////////////////////////////////////////////////////////////////////////////////
 void GLScene::doCenter() {
 	viewport->reframe(world->collection()->boundingBox(),1.6);
+	requestRender();
 }
 void GLScene::toggleProjection() {
 	sceneOrthographic = !sceneOrthographic;
@@ -236,9 +268,11 @@ void GLScene::toggleProjection() {
 	} else {
 		button_projection->setIcon(QIcon(":/icon/glview/projection_perspective.png"));
 	}
+	requestRender();
 }
 void GLScene::toggleShadow() {
 	sceneShadowed = !sceneShadowed;
+	requestRender();
 }
 void GLScene::toggleMaterialMode() {
 	sceneWireframe = !sceneWireframe;
@@ -247,25 +281,82 @@ void GLScene::toggleMaterialMode() {
 	} else {
 		button_material_mode->setIcon(QIcon(":/icon/glview/render_shaded.png"));
 	}
+	requestRender();
 }
 void GLScene::saveScreenshot() {
-	QGLFramebufferObjectFormat format;
-	format.setSamples(16);
-
 	//Determine best maximum size
-	float aspectRatio = previousRect.height() / previousRect.width();
-	int width = fw_editor_settings->value("screenshot.width").toInt();
-	int height = width*aspectRatio;
+	int width,height;
+	getScreenshotSize(&width,&height);
+
+	//Render image and save it
+	QImage image = renderScreenshot(width,height);
+	QString fileName = QFileDialog::getSaveFileName(static_cast<QWidget*>(this->parent()), "Save Screenshot", "",
+		"JPEG/PNG image (*.jpg;*.png);;"
+		"All files (*.*)");
+
+	if (!fileName.isEmpty()) {
+		image.save(fileName,0,95);
+	}
+
+	editor->getEditorWindow()->getMainWindow()->statusBar()->showMessage("Saved screenshot ("+fileName+")",3000);
+}
+void GLScene::saveSheets() {
+	progressDialog = new QProgressDialog("Exporting schematics sheets...","Abort",0,1);
+	progressDialog->show();
+
+	exportSheets("");
+	editor->getEditorWindow()->getMainWindow()->statusBar()->showMessage("Finished exporting sheets!",3000);
+
+	delete progressDialog;
+	progressDialog = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get size of the screenshot from settings, keeping aspect ratio of the view
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::getScreenshotSize(int* width, int* height) {
+	//View was not drawn yet (no visible window)
+	QRectF rect = previousRect;
+	if (rect.width() <= 0.0) rect = sceneRect();
+
+	float aspectRatio = 0.75f;
+	if ((rect.width() > 0.0) && (rect.height() > 0.0)) aspectRatio = rect.height() / rect.width();
+	*width = fw_editor_settings->value("screenshot.width").toInt();
+	*height = (*width)*aspectRatio;
 
 	if (fw_editor_settings->value("screenshot.height").toInt() > 0) {
-		height = fw_editor_settings->value("screenshot.height").toInt();
+		*height = fw_editor_settings->value("screenshot.height").toInt();
 	} else {
-		if (height > fw_editor_settings->value("screenshot.width").toInt()) {
-			height = fw_editor_settings->value("screenshot.width").toInt();
-			width = height/aspectRatio;
+		if (*height > fw_editor_settings->value("screenshot.width").toInt()) {
+			*height = fw_editor_settings->value("screenshot.width").toInt();
+			*width = (*height)/aspectRatio;
 		}
 	}
-	
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Make OpenGL context of the view current.
+///
+/// Framebuffers used for screenshots are created in the current context, which is
+/// not set up by the paint event if the view was never shown (headless rendering).
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::makeCurrent() {
+	QGraphicsView* view = views().value(0);
+	if (!view) return;
+
+	QGLWidget* glwidget = qobject_cast<QGLWidget*>(view->viewport());
+	if (glwidget) glwidget->makeCurrent();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Render view into an image of given size (without interface elements)
+////////////////////////////////////////////////////////////////////////////////
+QImage GLScene::renderScreenshot(int width, int height) {
+	makeCurrent();
+
 	//Create FBO and draw into it
 	QGLFramebufferObject renderFbo(width,height);
 	QPainter fboPainter(&renderFbo);
@@ -284,86 +375,284 @@ void GLScene::saveScreenshot() {
 		panel_view->show();
 
 	fboPainter.end();
+	return renderFbo.toImage();
+}
 
-	//Get image and save it
-	QString fileName = QFileDialog::getSaveFileName(static_cast<QWidget*>(this->parent()), "Save Screenshot", "",
-		"JPEG/PNG image (*.jpg;*.png);;"
-		"All files (*.*)");
 
-	if (!fileName.isEmpty()) {
-		renderFbo.toImage().save(fileName,0,95);
-	}
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Export every schematics sheet into the given folder.
+///
+/// Returns number of sheets written. Progress dialog is used if one is shown.
+////////////////////////////////////////////////////////////////////////////////
+int GLScene::exportSheets(const QString& outputPath, int* sheets_failed) {
+	if (sheets_failed) *sheets_failed = 0;
+	if (!schematics_editor) return 0;
+	makeCurrent();
 
-	editor->getEditorWindow()->getMainWindow()->statusBar()->showMessage("Saved screenshot ("+fileName+")",3000);
-}
-void GLScene::saveSheets() {
 	QString baseFilename = editor->getEditorWindow()->getCurrentFile();
 	QFileInfo baseInfo = QFileInfo(baseFilename);
-	progressDialog = new QProgressDialog("Exporting schematics sheets...","Abort",0,1);
-	progressDialog->show();
+	QDir outputDir = QDir(outputPath);
 
 	Object* old_sheet = schematics_editor->getCurrentSheet();
 	int sheet_no = 1;
+	int sheets_written = 0;
 	for (int i = 0; i < schematics_editor->getMetadataRoot()->getChildrenCount(); i++) {
 		Object* sheet = schematics_editor->getMetadataRoot()->getChild(i);
-		if (sheet->getType() == "foxworks.schematics.sheet") {
+		if (sheet->getTypeId() == Object::TYPE_SCHEMATICS_SHEET) {
 			schematics_editor->setCurrentSheet(sheet);
 			schematics_editor->getSchematicsRenderingManager()->updateInstances();
 
-			QString code = sheet->getString("sheet.code");
-			if (code == "") code = editor->getEditDocument()->getString("document.code");
+			QString code = sheet->getString(var_sheet_code);
+			if (code == "") code = editor->getEditDocument()->getString(var_document_code);
 			if (code == "") code = baseInfo.baseName();
-			if (sheet->getVariable("sheet.number") > 0.0) sheet_no = (int)sheet->getVariable("sheet.number");
+			if (sheet->getVariable(var_sheet_number) > 0.0) sheet_no = (int)sheet->getVariable(var_sheet_number);
 
 			editor->getEditorWindow()->getMainWindow()->statusBar()->showMessage(tr("Exporting sheet #%1..").arg(sheet_no),2000);
-			saveCurrentSheet(tr("%1 (sheet %2).jpg")
+			if (saveCurrentSheet(outputDir.filePath(tr("%1 (sheet %2).png")
 				.arg(code)
-				.arg(sheet_no));
+				.arg(sheet_no)))) {
+				sheets_written++;
+			} else if (sheets_failed) {
+				(*sheets_failed)++;
+			}
+			if (progressDialog && progressDialog->wasCanceled()) break;
 
 			sheet_no++;
 		}
 	}
 	schematics_editor->setCurrentSheet(old_sheet);
 	schematics_editor->getSchematicsRenderingManager()->updateInstances();
-	editor->getEditorWindow()->getMainWindow()->statusBar()->showMessage("Finished exporting sheets!",3000);
-
-	delete progressDialog;
-	progressDialog = 0;
+	return sheets_written;
 }
 void GLScene::setIsoView() {
 	viewport->cameraHandle()->setIsoView();
+	requestRender();
 }
 void GLScene::setLeftView() {
 	viewport->cameraHandle()->setFrontView();
+	requestRender();
 }
 void GLScene::setRightView() {
 	viewport->cameraHandle()->setRearView();
+	requestRender();
 }
 void GLScene::setFrontView() {
 	viewport->cameraHandle()->setLeftView();
+	requestRender();
 }
 void GLScene::setBackView() {
 	viewport->cameraHandle()->setRightView();
+	requestRender();
 }
 void GLScene::setTopView() {
 	viewport->cameraHandle()->setTopView();
+	requestRender();
 }
 void GLScene::setBottomView() {
 	viewport->cameraHandle()->setBottomView();
+	requestRender();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get approximate size of the instance on screen.
+///
+/// Returns radius of the bounding sphere relative to half of the view height, or
+/// zero if the instance is hidden or lies outside of the view.
+////////////////////////////////////////////////////////////////////////////////
+double GLScene::getScreenFraction(GLC_3DViewInstance* instance) {
+	if (!instance->isVisible()) return 0.0;
+	GLC_BoundingBox box = instance->boundingBox();
+	if (box.isEmpty()) return 0.0;
+
+	double fraction;
+	if (!projectSphere(box.center(),box.boundingSphereRadius(),&fraction)) return 0.0;
+	return fraction;
+}
+
+double GLScene::getScreenFraction(const GLC_Point3d& center, double radius) {
+	double fraction;
+	if (!projectSphere(center,radius,&fraction)) return 0.0;
+	return fraction;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check if instance is inside of the view. Instances without a mesh are
+///  checked by their origin.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::isInView(GLC_3DViewInstance* instance) {
+	if (!instance->isVisible()) return false;
+	GLC_BoundingBox box = instance->boundingBox();
+	if (box.isEmpty()) {
+		return projectSphere(instance->matrix() * GLC_Point3d(0.0,0.0,0.0),0.0,0);
+	} else {
+		return projectSphere(box.center(),box.boundingSphereRadius(),0);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get radius of the sphere relative to half of the view height. Returns
+///  false if sphere is outside of the view.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::projectSphere(const GLC_Point3d& center, double radius, double* fraction) {
+	//Position of the object relative to camera
+	GLC_Camera* camera = viewport->cameraHandle();
+	GLC_Vector3d forward = camera->target() - camera->eye();
+	forward.normalize();
+	GLC_Vector3d offset = center - camera->eye();
+	double depth = offset * forward;
+	double lateral = (offset - forward*depth).length();
+
+	//Half of the visible height at the depth of the object
+	double tanHalfAngle = tan(0.5*viewport->viewAngle()*glc::PI/180.0);
+	double halfHeight;
+	if (sceneOrthographic) {
+		halfHeight = camera->distEyeTarget()*tanHalfAngle;
+	} else {
+		if (depth < -radius) return false; //Behind the camera
+		halfHeight = qMax(depth,radius)*tanHalfAngle;
+	}
+	if (halfHeight <= 0.0) return false;
+
+	//Check against circle around the view
+	double aspectRatio = 1.0;
+	if (previousRect.height() > 0.0) aspectRatio = previousRect.width() / previousRect.height();
+	if (lateral - radius > halfHeight*sqrt(1.0 + aspectRatio*aspectRatio)) return false;
+	if (fraction) *fraction = radius / halfHeight;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Scene contents have changed (meshes, positions, information)
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::invalidate() {
+	sceneGeneration++;
+	scheduleRender();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Redraw only if something visible has changed since the last frame
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::requestRender() {
+	if (!isRenderStateChanged()) return;
+	scheduleRender();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Schedule a redraw, coalescing requests and limiting frame rate while dragging
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::scheduleRender() {
+	if (renderTimer.isActive()) return; //Frame is already scheduled
+
+	//Limit frame rate while mover controller is active
+	int delay = 0;
+	if (controller.hasActiveMover()) {
+		int max_fps = fw_editor_settings->value("rendering.interactive_fps").toInt();
+		if (max_fps > 0) {
+			delay = 1000/max_fps - lastFrameTime.elapsed();
+		}
+	}
+
+	if (delay > 0) {
+		renderTimer.start(delay);
+	} else {
+		update();
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+int GLScene::getOverlayState() {
+	int state = 0;
+	if (sceneOrthographic)				state |= 0x01;
+	if (sceneShadowed)					state |= 0x02;
+	if (sceneWireframe)					state |= 0x04;
+	if (controller.hasActiveMover())	state |= 0x08;
+	if (cutsectionPlaneWidget[0])		state |= 0x10;
+	if (cutsectionPlaneWidget[1])		state |= 0x20;
+	if (cutsectionPlaneWidget[2])		state |= 0x40;
+	return state;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::isRenderStateChanged() {
+	if (!sceneInitialized) return true;
+	if (renderedGeneration != sceneGeneration) return true;
+	if (renderedOverlay != getOverlayState()) return true;
+	if (renderedSelection != editor->getSelected()) return true;
+	if (renderedViewAngle != viewport->viewAngle()) return true;
+	if (!(renderedCamera == viewport->cameraHandle()->modelViewMatrix())) return true;
+	return false;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void GLScene::saveCurrentSheet(const QString& baseFilename) {
-	if (!schematics_editor->getCurrentSheet()) return;
+void GLScene::saveRenderState() {
+	renderedGeneration = sceneGeneration;
+	renderedOverlay = getOverlayState();
+	renderedSelection = editor->getSelected();
+	renderedViewAngle = viewport->viewAngle();
+	renderedCamera = viewport->cameraHandle()->modelViewMatrix();
+	lastFrameTime.restart();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Coarsen or refine interactive level of detail based on last frame time
+///
+/// Higher minimum pixel culling size also makes GLC pick coarser LODs for the
+/// objects that remain visible.
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::adjustInteractiveQuality(int frame_time) {
+	int target_time = fw_editor_settings->value("rendering.interactive_frame_time").toInt();
+	int min_culling = qMax(1,fw_editor_settings->value("rendering.min_pixel_culling").toInt());
+	if (target_time <= 0) return;
+
+	if ((frame_time > target_time) && (interactiveCulling < 256)) {
+		interactiveCulling *= 2;
+	} else if ((frame_time < target_time/2) && (interactiveCulling > min_culling)) {
+		interactiveCulling /= 2;
+	}
+	if (interactiveCulling < min_culling) interactiveCulling = min_culling;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy tile read back from OpenGL (bottom to top) into image strip
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_GLScene_CopyTile(const uchar* tile, int tile_size, QByteArray& strip, int width, int height, int x) {
+	if (!tile) return;
+	int columns = qMin(tile_size,width-x);
+	for (int row = 0; row < height; row++) {
+		memcpy(strip.data() + (row*width + x)*4,tile + (tile_size-1-row)*tile_size*4,columns*4);
+	}
+}
+
 
-	QGLFramebufferObjectFormat format;
-	format.setSamples(16);
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Render current sheet tile by tile, streaming image strips to disk
+///
+/// A single multisampled framebuffer is reused for all tiles. Each tile is read
+/// back through a pixel buffer while the next one is rendered, and finished
+/// strips of tiles are encoded into PNG file by a separate thread.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::saveCurrentSheet(const QString& baseFilename) {
+	if (!schematics_editor->getCurrentSheet()) return false;
 
 	//Get number of pixels per cm
-	float ppcm = schematics_editor->getCurrentSheet()->getVariable("paper.ppcm");
+	float ppcm = schematics_editor->getCurrentSheet()->getVariable(var_paper_ppcm);
 	if (ppcm <= 0.0) ppcm = 32.0;
 
 	//Get paper size
@@ -373,81 +662,160 @@ void GLScene::saveCurrentSheet(const QString& baseFilename) {
 	//Get picture size
 	int width = paper_width*ppcm;
 	int height = paper_height*ppcm;
+	int tile_size = 1024;
+	if ((width <= 0) || (height <= 0)) return false;
+
+	//Start writing the image
+	SheetImageWriter writer(baseFilename,width,height);
+	if (!writer.open()) {
+		qWarning("GLScene: unable to write sheet image: %s",baseFilename.toUtf8().data());
+		return false;
+	}
 
-	//Create final image buffer
-	QImage finalImage(width,height,QImage::Format_RGB32);
-	int fbo_width = 1024;
-	int fbo_height = 1024;
-	int x = 0;
-	int y = 0;
+	//Create framebuffer for rendering (resolved into a regular one if multisampled)
+	QGLFramebufferObject* renderFbo;
+	QGLFramebufferObject* readFbo;
+	if (QGLFramebufferObject::hasOpenGLFramebufferBlit()) {
+		QGLFramebufferObjectFormat format;
+		format.setAttachment(QGLFramebufferObject::CombinedDepthStencil);
+		format.setSamples(16);
+		renderFbo = new QGLFramebufferObject(tile_size,tile_size,format);
+	} else {
+		renderFbo = new QGLFramebufferObject(tile_size,tile_size,QGLFramebufferObject::CombinedDepthStencil);
+	}
+	if (renderFbo->format().samples() > 0) {
+		readFbo = new QGLFramebufferObject(tile_size,tile_size);
+	} else {
+		readFbo = renderFbo;
+	}
+
+	//Create pixel buffers for asynchronous reading
+	QGLBuffer pixelBuffer0(QGLBuffer::PixelPackBuffer);
+	QGLBuffer pixelBuffer1(QGLBuffer::PixelPackBuffer);
+	QGLBuffer* pixelBuffers[2] = { &pixelBuffer0, &pixelBuffer1 };
+	QByteArray tile;
+	bool usePixelBuffers = pixelBuffer0.create() && pixelBuffer1.create();
+	if (usePixelBuffers) {
+		for (int i = 0; i < 2; i++) {
+			pixelBuffers[i]->setUsagePattern(QGLBuffer::StreamRead);
+			pixelBuffers[i]->bind();
+			pixelBuffers[i]->allocate(tile_size*tile_size*4);
+			pixelBuffers[i]->release();
+		}
+	} else {
+		tile.resize(tile_size*tile_size*4);
+	}
 
 	//Update progress dialog
 	if (progressDialog && (progressDialog->maximum() == 1)) {
-		progressDialog->setMaximum((width / fbo_width + 1)*(height / fbo_height + 1)*schematics_editor->getMetadataRoot()->getChildrenCount());
+		progressDialog->setMaximum((width / tile_size + 1)*(height / tile_size + 1)*schematics_editor->getMetadataRoot()->getChildrenCount());
 	}
 
-	//Save camera
+	//Save camera and setup scene for rendering tiles
 	GLC_Camera old_camera = GLC_Camera(*viewport->cameraHandle());
-	
-	while (x < width) {
-		y = 0;
-		while (y < height) {
-			progressDialog->setValue(progressDialog->value()+1);
-
-			//Create FBO and draw into it
-			QGLFramebufferObject renderFbo(fbo_width,fbo_height);
-			QPainter fboPainter(&renderFbo);
-			fboPainter.setRenderHint(QPainter::Antialiasing);
-			fboPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+	QRectF oldRect = sceneRect();
+	setSceneRect(QRectF(0,0,tile_size,tile_size));
+	panel_control->hide();
+	panel_view->hide();
+	makingScreenshot = true;
+
+	//Offsets in meters
+	float xstep = (tile_size/ppcm)*0.01f;
+	float ystep = (tile_size/ppcm)*0.01f;
+
+	bool aborted = false;
+	for (int y = 0; (y < height) && (!aborted); y += tile_size) {
+		int strip_height = qMin(tile_size,height-y);
+		QByteArray strip(width*strip_height*4,(char)255);
+
+		int tile_index = 0;
+		for (int x = 0; x < width; x += tile_size, tile_index++) {
+			if (progressDialog) {
+				progressDialog->setValue(progressDialog->value()+1);
+				if (progressDialog->wasCanceled()) {
+					aborted = true;
+					break;
+				}
+			}
 
-				//Offsets in meters
-				float xstep = (fbo_width/ppcm)*0.01f;
-				float ystep = (fbo_height/ppcm)*0.01f;
-
-				//Calculate proper camera offset
-				GLC_Vector3d targetVector(
-					xstep*0.5f + xstep*(x/((float)fbo_width)),
-					ystep*0.5f + ystep*((height-y)/((float)fbo_height) - 1),
-					0);
-
-				//if (width < fbo_width) targetVector.setX(0.0);
-				//if (height < fbo_height) targetVector.setY(0.0);
-
-				//Frame image correctly
-				viewport->cameraHandle()->translate(targetVector-viewport->cameraHandle()->target());
-				viewport->cameraHandle()->setDistEyeTarget(ystep*1.430f);
-
-				//Render
-				QRectF oldRect = sceneRect();
-				setSceneRect(QRectF(0,0,fbo_width,fbo_height));
-				panel_control->hide();
-				panel_view->hide();
-					makingScreenshot = true;
-					render(&fboPainter);
-					//fboPainter.drawText(0,50,tr("POSITION %1x%2").arg(x/2048).arg(0));
-					makingScreenshot = false;
-				setSceneRect(oldRect);
-				panel_control->show();
-				panel_view->show();
+			//Calculate proper camera offset and frame image correctly
+			GLC_Vector3d targetVector(
+				xstep*0.5f + xstep*(x/((float)tile_size)),
+				ystep*0.5f + ystep*((height-y)/((float)tile_size) - 1),
+				0);
+			viewport->cameraHandle()->translate(targetVector-viewport->cameraHandle()->target());
+			viewport->cameraHandle()->setDistEyeTarget(ystep*1.430f);
 
+			//Render
+			QPainter fboPainter(renderFbo);
+			fboPainter.setRenderHint(QPainter::Antialiasing);
+			fboPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+				render(&fboPainter);
 			fboPainter.end();
 
-			QPainter painter(&finalImage);
-			painter.drawImage(x, y, renderFbo.toImage());
-			painter.end();
+			//Resolve multisampled image
+			if (readFbo != renderFbo) {
+				QGLFramebufferObject::blitFramebuffer(
+					readFbo,QRect(0,0,tile_size,tile_size),
+					renderFbo,QRect(0,0,tile_size,tile_size));
+			}
 
-			y += fbo_height;
+			//Read back pixels
+			readFbo->bind();
+			if (usePixelBuffers) {
+				QGLBuffer* buffer = pixelBuffers[tile_index % 2];
+				buffer->bind();
+				glReadPixels(0,0,tile_size,tile_size,GL_RGBA,GL_UNSIGNED_BYTE,0);
+				buffer->release();
+				readFbo->release();
+
+				//Copy previous tile while this one is being transferred
+				if (tile_index > 0) {
+					buffer = pixelBuffers[(tile_index-1) % 2];
+					buffer->bind();
+					FWE_GLScene_CopyTile((const uchar*)buffer->map(QGLBuffer::ReadOnly),
+						tile_size,strip,width,strip_height,x-tile_size);
+					buffer->unmap();
+					buffer->release();
+				}
+			} else {
+				glReadPixels(0,0,tile_size,tile_size,GL_RGBA,GL_UNSIGNED_BYTE,tile.data());
+				readFbo->release();
+				FWE_GLScene_CopyTile((const uchar*)tile.constData(),tile_size,strip,width,strip_height,x);
+			}
+		}
+		if (aborted) break;
+
+		//Copy last tile in the strip
+		if (usePixelBuffers && (tile_index > 0)) {
+			QGLBuffer* buffer = pixelBuffers[(tile_index-1) % 2];
+			buffer->bind();
+			FWE_GLScene_CopyTile((const uchar*)buffer->map(QGLBuffer::ReadOnly),
+				tile_size,strip,width,strip_height,(tile_index-1)*tile_size);
+			buffer->unmap();
+			buffer->release();
 		}
 
-		x += fbo_width;
+		//Send strip to the encoder
+		writer.writeStrip(strip);
 	}
 
-	//Restore camera
+	//Restore scene and camera
+	makingScreenshot = false;
+	setSceneRect(oldRect);
+	panel_control->show();
+	panel_view->show();
 	viewport->cameraHandle()->setCam(old_camera);
 
-	//Save image
-	finalImage.save(baseFilename,0,95);
-	//renderFbo.toImage().save(baseFilename,0,95);
+	if (readFbo != renderFbo) delete readFbo;
+	delete renderFbo;
+
+	//Finish writing image
+	if (!writer.finish()) {
+		if (!aborted) qWarning("GLScene: error while writing sheet image: %s",baseFilename.toUtf8().data());
+		return false;
+	}
+	return true;
 }
 
 
@@ -491,6 +859,7 @@ void GLScene::setCutsectionPlane(int plane, bool active) {
 		cutsectionPlaneWidget[plane] = 0;
 		viewport->removeClipPlane(GL_CLIP_PLANE0 + plane);
 	}
+	requestRender();
 }
 
 
@@ -572,16 +941,16 @@ QPointF GLScene::project(float x, float y, float z) {
 void GLScene::drawSchematicsElement(QPainter *painter, Object* element, QPointF offset) {
 	for (int i = 0; i < element->getChildrenCount(); i++) {
 		Object* child = element->getChild(i);
-		if (child->getType() == "foxworks.schematics.element") {
+		if (child->getTypeId() == Object::TYPE_SCHEMATICS_ELEMENT) {
 			//Get state vector
 			EVDS_STATE_VECTOR vector;
 			EVDS_Object_GetStateVector(child->getEVDSObject(),&vector);
 
 			//Draw if it's a label
-			if (child->getString("reference") == "") {
+			if (child->getString(var_reference) == "") {
 				float font_size = 0.005f; //FIXME
 				QString value = element->getName();
-				if (child->getString("text") != "") value = child->getString("text");
+				if (child->getString(var_text) != "") value = child->getString(var_text);
 				
 				//Fake multi-line text
 				QStringList lines = value.split("\n");
@@ -641,8 +1010,8 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 	int sectionMulW = 1;
 	int sectionMulH = 1;
 
-	double wm = sheet->getVariable("paper.width_multiplier");
-	double hm = sheet->getVariable("paper.height_multiplier");
+	double wm = sheet->getVariable(var_paper_width_multiplier);
+	double hm = sheet->getVariable(var_paper_height_multiplier);
 	if (wm > 1.0) sectionMulW = (int)wm;
 	if (hm > 1.0) sectionMulH = (int)hm;
 
@@ -703,11 +1072,11 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 			painter->drawText(local(0.170,0.019),"Scale");
 
 			//Fill out fields
-			painter->drawText(local(0.018,0.014),editor->getEditDocument()->getString("document.created_by"));
-			painter->drawText(local(0.018,0.019),editor->getEditDocument()->getString("document.drawn_by"));
-			painter->drawText(local(0.018,0.024),editor->getEditDocument()->getString("document.verified_by"));
+			painter->drawText(local(0.018,0.014),editor->getEditDocument()->getString(var_document_created_by));
+			painter->drawText(local(0.018,0.019),editor->getEditDocument()->getString(var_document_drawn_by));
+			painter->drawText(local(0.018,0.024),editor->getEditDocument()->getString(var_document_verified_by));
 
-			double scale = sheet->getVariable("sheet.scale");
+			double scale = sheet->getVariable(var_sheet_scale);
 			if (scale <= 0.0) scale = 1.0;
 			painter->drawText(local(0.170,0.024),"1:" + tr("%1").arg(scale));
 		painter->setFont(QFont("GOST type B",normal_font_px));
@@ -717,25 +1086,25 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 		QString value;
 
 
-		if (sheet->getString("sheet.code") != "") {
-			value = sheet->getString("sheet.code");
+		if (sheet->getString(var_sheet_code) != "") {
+			value = sheet->getString(var_sheet_code);
 		} else {
-			value = editor->getEditDocument()->getString("document.code");
+			value = editor->getEditDocument()->getString(var_document_code);
 		}
 		painter->drawText(local(0.065 + 0.5*(0.185-0.065),0.000 + 0.5*(0.000-0.015) + 0.001)
 			-QPointF(metric.width(value)/2,-metric.height()/2),value);
 
 
-		if (sheet->getString("sheet.title") != "") {
-			value = sheet->getString("sheet.title");
+		if (sheet->getString(var_sheet_title) != "") {
+			value = sheet->getString(var_sheet_title);
 		} else {
-			value = editor->getEditDocument()->getString("document.title");
+			value = editor->getEditDocument()->getString(var_document_title);
 		}
 		painter->drawText(local(0.065 + 0.5*(0.135-0.065),0.015 + 0.5*(0.015-0.040) + 0.001)
 			-QPointF(metric.width(value)/2,-metric.height()/2),value);
 
 
-		value = editor->getEditDocument()->getString("document.company");
+		value = editor->getEditDocument()->getString(var_document_company);
 		painter->drawText(local(0.135 + 0.5*(0.185-0.135),0.025 + 0.5*(0.025-0.040) + 0.001)
 			-QPointF(metric.width(value)/2,-metric.height()/2),value);
 
@@ -815,6 +1184,7 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 		qWarning("GLScene: requires valid OpenGL context");
 		return;
 	}
+	FWE_TRACE("GLScene::drawBackground");
 
 	//Initialize scene
 	if (!sceneInitialized) {
@@ -834,6 +1204,17 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 		loadShaders();
 	}
 
+	//Check if previous frame can be displayed again (nothing has changed since)
+	bool inSelectionMode = GLC_State::isInSelectionMode();
+	bool reuseFrame = (!inSelectionMode) && (!makingScreenshot) && fbo_fxaa &&
+		(rect == previousRect) && (!isRenderStateChanged());
+
+	//Skip expensive passes while camera is being moved (full frame is drawn once it stops)
+	bool interactiveFrame = (!inSelectionMode) && (!makingScreenshot) && controller.hasActiveMover() &&
+		(fw_editor_settings->value("rendering.interactive_quality") == true);
+	QTime frameTime;
+	frameTime.start();
+
 	//Setup native rendering and viewport size
 	painter->beginNativePainting();
 	glClearColor(1.0f,1.0f,1.0f,0.0f);
@@ -864,7 +1245,6 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 	} else {
 		viewport->setToOrtho(sceneOrthographic);
 	}
-	bool inSelectionMode = GLC_State::isInSelectionMode();
 
 	//Process selection from the editor
 	world->collection()->unselectAll();
@@ -876,6 +1256,9 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 	if (makingScreenshot) {
 		viewport->setMinimumPixelCullingSize(0);
 		world->collection()->setLodUsage(false,viewport);
+	} else if (interactiveFrame) {
+		viewport->setMinimumPixelCullingSize(interactiveCulling);
+		world->collection()->setLodUsage(true,viewport);
 	} else {
 		viewport->setMinimumPixelCullingSize(fw_editor_settings->value("rendering.min_pixel_culling").toInt());
 		world->collection()->setLodUsage(true,viewport);
@@ -886,35 +1269,37 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 	//Clear screen and buffers
 	glClearColor(1.0f,1.0f,1.0f,0.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	if (fbo_outline) {
-		fbo_outline->bind();
-			glClearColor(0.0f,0.0f,0.0f,0.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		fbo_outline->release();
-	}
-	if (fbo_outline_selected) {
-		fbo_outline_selected->bind();
-			glClearColor(0.0f,0.0f,0.0f,0.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		fbo_outline_selected->release();
-	}
-	if (fbo_shadow) {
-		fbo_shadow->bind();
-			glClearColor(0.0f,0.0f,0.0f,0.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		fbo_shadow->release();
-	}
-	if (fbo_fxaa) {
-		fbo_fxaa->bind();
-			glClearColor(1.0f,1.0f,1.0f,0.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		fbo_fxaa->release();
+	if (!reuseFrame) {
+		if (fbo_outline) {
+			fbo_outline->bind();
+				glClearColor(0.0f,0.0f,0.0f,0.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			fbo_outline->release();
+		}
+		if (fbo_outline_selected) {
+			fbo_outline_selected->bind();
+				glClearColor(0.0f,0.0f,0.0f,0.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			fbo_outline_selected->release();
+		}
+		if (fbo_shadow) {
+			fbo_shadow->bind();
+				glClearColor(0.0f,0.0f,0.0f,0.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			fbo_shadow->release();
+		}
+		if (fbo_fxaa) {
+			fbo_fxaa->bind();
+				glClearColor(1.0f,1.0f,1.0f,0.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			fbo_fxaa->release();
+		}
 	}
 
 
 	//==========================================================================
 	//Draw background
-	if ((!inSelectionMode) && (!schematics_editor)) {
+	if ((!inSelectionMode) && (!schematics_editor) && (!reuseFrame)) {
 		if (fbo_fxaa) fbo_fxaa->bind();
 			if (shader_background) {
 				shader_background->bind();
@@ -935,40 +1320,57 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 	light[0]->setPosition(viewport->cameraHandle()->eye() - viewport->cameraHandle()->forward() * 1000.0); //Parallel lighting
 	light[0]->glExecute(); //Scene light #1
 
-	//Draw into outline buffer
-	if ((!inSelectionMode) && fbo_outline) {
-		fbo_outline->bind();
-			world->render(0, glc::OutlineSilhouetteRenderFlag);
-			world->render(1, glc::OutlineSilhouetteRenderFlag);
-		fbo_outline->release();
-	}
-	if ((!inSelectionMode) && fbo_outline_selected) {
-		fbo_outline_selected->bind();
-			world->render(1, glc::OutlineSilhouetteRenderFlag);
-		fbo_outline_selected->release();
-	}
-
+	//Render the frame (unless previous one can be displayed again)
+	if (!reuseFrame) {
+		//Draw into outline buffer
+		if ((!inSelectionMode) && (!interactiveFrame) && fbo_outline) {
+			FWE_TRACE("GLScene::outlinePass");
+			fbo_outline->bind();
+				world->render(0, glc::OutlineSilhouetteRenderFlag);
+				world->render(1, glc::OutlineSilhouetteRenderFlag);
+			fbo_outline->release();
+		}
+		if ((!inSelectionMode) && (!interactiveFrame) && fbo_outline_selected) {
+			FWE_TRACE("GLScene::selectedOutlinePass");
+			fbo_outline_selected->bind();
+				world->render(1, glc::OutlineSilhouetteRenderFlag);
+			fbo_outline_selected->release();
+		}
 
-	//Draw into shadows buffer
-	if ((!inSelectionMode) && fbo_shadow && shader_shadow && sceneShadowed && (!schematics_editor)) {
-		fbo_shadow->bind();
-			GLC_Context::current()->glcPushMatrix();
-			GLC_Context::current()->glcTranslated(0,0,1.2*world->collection()->boundingBox().lowerCorner().z());
-			GLC_Context::current()->glcScaled(1,1,0);
-				//viewport->setWinGLSize(rect.width()/2, rect.height()/2);
-				world->collection()->setLodUsage(false,viewport);
 
-				world->render(0, glc::ShadingFlag);
-				world->render(1, glc::ShadingFlag);
+		//Draw into shadows buffer
+		if ((!inSelectionMode) && (!interactiveFrame) && fbo_shadow && shader_shadow && sceneShadowed && (!schematics_editor)) {
+			FWE_TRACE("GLScene::shadowPass");
+			fbo_shadow->bind();
+				GLC_Context::current()->glcPushMatrix();
+				GLC_Context::current()->glcTranslated(0,0,1.2*world->collection()->boundingBox().lowerCorner().z());
+				GLC_Context::current()->glcScaled(1,1,0);
+					//viewport->setWinGLSize(rect.width()/2, rect.height()/2);
+					world->collection()->setLodUsage(false,viewport);
+
+					world->render(0, glc::ShadingFlag);
+					world->render(1, glc::ShadingFlag);
+
+					world->collection()->setLodUsage(true,viewport);
+					//viewport->setWinGLSize(rect.width(), rect.height());
+				GLC_Context::current()->glcPopMatrix();
+			fbo_shadow->release();
 
-				world->collection()->setLodUsage(true,viewport);
-				//viewport->setWinGLSize(rect.width(), rect.height());
-			GLC_Context::current()->glcPopMatrix();
-		fbo_shadow->release();
+			//Make shadows even more blurry
+			for (int i = 0; i < 8; i++) {
+				fbo_shadow->bind();
+					viewport->useClipPlane(false);
+					glBindTexture(GL_TEXTURE_2D, fbo_shadow->texture());
+					shader_shadow->bind();
+					shader_shadow->setUniformValue("s_Data",0);
+					shader_shadow->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
+					drawScreenQuad();
+					shader_shadow->release();
+					viewport->useClipPlane(true);
+				fbo_shadow->release();
+			}
 
-		//Make shadows even more blurry
-		for (int i = 0; i < 8; i++) {
-			fbo_shadow->bind();
+			if (fbo_fxaa) fbo_fxaa->bind();
 				viewport->useClipPlane(false);
 				glBindTexture(GL_TEXTURE_2D, fbo_shadow->texture());
 				shader_shadow->bind();
@@ -977,108 +1379,109 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 				drawScreenQuad();
 				shader_shadow->release();
 				viewport->useClipPlane(true);
-			fbo_shadow->release();
+			if (fbo_fxaa) fbo_fxaa->release();
 		}
 
-		if (fbo_fxaa) fbo_fxaa->bind();
-			viewport->useClipPlane(false);
-			glBindTexture(GL_TEXTURE_2D, fbo_shadow->texture());
-			shader_shadow->bind();
-			shader_shadow->setUniformValue("s_Data",0);
-			shader_shadow->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
-			drawScreenQuad();
-			shader_shadow->release();
-			viewport->useClipPlane(true);
-		if (fbo_fxaa) fbo_fxaa->release();
-	}
-
-	//Render scene into world
-	if ((!inSelectionMode) && fbo_fxaa) fbo_fxaa->bind();
-		if (!sceneWireframe && (!schematics_editor)) {
-			world->render(0, glc::ShadingFlag);
-			//glClear(GL_DEPTH_BUFFER_BIT);
-			world->render(1, glc::ShadingFlag);
-		}
-		if (!makingScreenshot) {
-			viewport->useClipPlane(false);
-			widget_manager->render();
-			viewport->useClipPlane(true);
-		}
-	if ((!inSelectionMode) && fbo_fxaa) fbo_fxaa->release();
-
-
-	//==========================================================================
-	//Draw the rest of UI related stuff/outlines without clipping planes
-	viewport->useClipPlane(false);
-
-	//Draw object outlines
-	if ((!inSelectionMode) && fbo_outline && shader_outline) {
-		if (fbo_fxaa) fbo_fxaa->bind();
-			shader_outline->bind();
-			shader_outline->setUniformValue("s_Data",0);
-			shader_outline->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
-			if (schematics_editor) {
-				float thickness = fabs(project(0.0,0.0).y() - project(0.0,0.0007f).y())*0.5f;
-				if (thickness < 0.5) thickness = 0.5;
-				shader_outline->setUniformValue("f_outlineThickness",thickness);
-			} else {
-				shader_outline->setUniformValue("f_outlineThickness",
-					(GLfloat)fw_editor_settings->value("rendering.outline_thickness").toDouble()
-				);
+		//Render scene into world
+		if ((!inSelectionMode) && fbo_fxaa) fbo_fxaa->bind();
+			if (!sceneWireframe && (!schematics_editor)) {
+				FWE_TRACE("GLScene::scenePass");
+				world->render(0, glc::ShadingFlag);
+				//glClear(GL_DEPTH_BUFFER_BIT);
+				world->render(1, glc::ShadingFlag);
 			}
-				glBindTexture(GL_TEXTURE_2D, fbo_outline->texture());
-				drawScreenQuad();
-				glBindTexture(GL_TEXTURE_2D, fbo_outline_selected->texture());
-				drawScreenQuad();
-			shader_outline->release();
-		if (fbo_fxaa) fbo_fxaa->release();
-	}
-
-	//Draw schematics
-	/*if (fbo_fxaa) fbo_fxaa->bind();
-		if (schematics_editor) { //Draw schematics page in world
-			viewport->useClipPlane(false);
-				QPainter fbo_painter(fbo_fxaa);
-				if (makingScreenshot) {
-					drawSchematicsPage(painter);
+			if (!makingScreenshot) {
+				viewport->useClipPlane(false);
+				widget_manager->render();
+				viewport->useClipPlane(true);
+			}
+		if ((!inSelectionMode) && fbo_fxaa) fbo_fxaa->release();
+
+
+		//==========================================================================
+		//Draw the rest of UI related stuff/outlines without clipping planes
+		viewport->useClipPlane(false);
+
+		//Draw object outlines
+		if ((!inSelectionMode) && (!interactiveFrame) && fbo_outline && shader_outline) {
+			FWE_TRACE("GLScene::outlineCompose");
+			if (fbo_fxaa) fbo_fxaa->bind();
+				shader_outline->bind();
+				shader_outline->setUniformValue("s_Data",0);
+				shader_outline->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
+				if (schematics_editor) {
+					float thickness = fabs(project(0.0,0.0).y() - project(0.0,0.0007f).y())*0.5f;
+					if (thickness < 0.5) thickness = 0.5;
+					shader_outline->setUniformValue("f_outlineThickness",thickness);
 				} else {
-					drawSchematicsPage(&fbo_painter);
+					shader_outline->setUniformValue("f_outlineThickness",
+						(GLfloat)fw_editor_settings->value("rendering.outline_thickness").toDouble()
+					);
 				}
-			viewport->useClipPlane(true);
+					glBindTexture(GL_TEXTURE_2D, fbo_outline->texture());
+					drawScreenQuad();
+					glBindTexture(GL_TEXTURE_2D, fbo_outline_selected->texture());
+					drawScreenQuad();
+				shader_outline->release();
+			if (fbo_fxaa) fbo_fxaa->release();
 		}
-	if (fbo_fxaa) fbo_fxaa->release();*/
 
-	//Draw controller UI
-	if (!inSelectionMode) {
-		if (fbo_fxaa) fbo_fxaa->bind();
-			//Draw CM indicator
-			glClear(GL_DEPTH_BUFFER_BIT);
-			if (editor->getSelected()) {
-				bool cm1 = editor->getSelected()->isInformationDefined("total_cm");
-				bool cm2 = editor->getSelected()->isInformationDefined("cm");
-				if (cm1 || cm2) {
-					QVector3D position = QVector3D();
-					if (cm1) {
-						position = editor->getSelected()->getInformationVector("total_cm");
+		//Draw schematics
+		/*if (fbo_fxaa) fbo_fxaa->bind();
+			if (schematics_editor) { //Draw schematics page in world
+				viewport->useClipPlane(false);
+					QPainter fbo_painter(fbo_fxaa);
+					if (makingScreenshot) {
+						drawSchematicsPage(painter);
 					} else {
-						position = editor->getSelected()->getInformationVector("cm");
+						drawSchematicsPage(&fbo_painter);
 					}
-
-					indicator_cm->resetMatrix();
-					indicator_cm->translate(position.x(),position.y(),position.z());
-					indicator_cm->multMatrix(editor->getSelected()->getRenderer()->getInstance()->matrix());
-					indicator_cm->render();
-				}
+				viewport->useClipPlane(true);
 			}
+		if (fbo_fxaa) fbo_fxaa->release();*/
+
+		//Draw controller UI
+		if (!inSelectionMode) {
+			if (fbo_fxaa) fbo_fxaa->bind();
+				//Draw CM indicator
+				glClear(GL_DEPTH_BUFFER_BIT);
+				if (editor->getSelected()) {
+					bool cm1 = editor->getSelected()->isInformationDefined("total_cm");
+					bool cm2 = editor->getSelected()->isInformationDefined("cm");
+					if (cm1 || cm2) {
+						QVector3D position = QVector3D();
+						if (cm1) {
+							position = editor->getSelected()->getInformationVector("total_cm");
+						} else {
+							position = editor->getSelected()->getInformationVector("cm");
+						}
+
+						indicator_cm->resetMatrix();
+						indicator_cm->translate(position.x(),position.y(),position.z());
+						indicator_cm->multMatrix(editor->getSelected()->getRenderer()->getInstance()->matrix());
+						indicator_cm->render();
+					}
+				}
 
-			controller.drawActiveMoverRep();
-		if (fbo_fxaa) fbo_fxaa->release();
+				controller.drawActiveMoverRep();
+			if (fbo_fxaa) fbo_fxaa->release();
+		}
+
+		//Remember what was drawn into the frame
+		if ((!inSelectionMode) && (!makingScreenshot)) {
+			saveRenderState();
+		}
+		if (interactiveFrame) {
+			adjustInteractiveQuality(frameTime.elapsed());
+		}
 	}
-	
+	viewport->useClipPlane(false);
+
 
 	//==========================================================================
 	//End FXAA and display it on screen
 	if ((!inSelectionMode) && fbo_fxaa) {
+		FWE_TRACE("GLScene::fxaaPass");
 		glBindTexture(GL_TEXTURE_2D, fbo_fxaa->texture());
 		shader_fxaa->bind();
 		shader_fxaa->setUniformValue("textureSampler",0);
@@ -1090,6 +1493,7 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 	//Draw 2D schematics page
 	//if (fbo_fxaa) fbo_fxaa->bind();
 		if (schematics_editor) {
+			FWE_TRACE("GLScene::schematicsPage");
 			viewport->useClipPlane(false);
 				//QPainter fbo_painter(fbo_fxaa);
 				//if (makingScreenshot) {
@@ -1125,23 +1529,23 @@ void GLScene::mousePressEvent(QGraphicsSceneMouseEvent* e) {
 		case (Qt::RightButton):
 			if (!schematics_editor) {
 				controller.setActiveMover(GLC_MoverController::TrackBall, GLC_UserInput(x,y));
-				update();
+				requestRender();
 			}
 			break;
 		case (Qt::LeftButton):
 			if (widget_manager->mousePressEvent(&mouseEvent) == glc::BlockedEvent) {
-				update();
+				invalidate();
 				break;
 			}
 
 			controller.setActiveMover(GLC_MoverController::Pan, GLC_UserInput(x,y));
 			//{ GLC_uint selectedID = viewport->renderAndSelect(x,y);
 			//qDebug("Id: %d\n",selectedID);}
-			update();
+			requestRender();
 			break;
 		case (Qt::MidButton):
 			controller.setActiveMover(GLC_MoverController::Zoom, GLC_UserInput(x,y));
-			update();
+			requestRender();
 			break;
 		default:
 			break;
@@ -1225,7 +1629,7 @@ void GLScene::mouseMoveEvent(QGraphicsSceneMouseEvent* e) {
 
 	//Process 3D widgets
 	if (widget_manager->mouseMoveEvent(&mouseEvent) == glc::BlockedEvent) {
-		update();
+		invalidate();
 		return;
 	}
 
@@ -1235,7 +1639,7 @@ void GLScene::mouseMoveEvent(QGraphicsSceneMouseEvent* e) {
 	if (controller.hasActiveMover()) {
 		controller.move(GLC_UserInput(x,y));
 		//viewport->setDistMinAndMax(world->collection()->boundingBox());
-		update();
+		requestRender();
 	}
 }
 
@@ -1253,13 +1657,13 @@ void GLScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* e) {
 
 	//Process 3D widgets
 	if (widget_manager->mouseReleaseEvent(&mouseEvent) == glc::BlockedEvent) {
-		update();
+		invalidate();
 		return;
 	}
 
 	//Stop moving the view
 	if (controller.hasActiveMover()) {
 		controller.setNoMover();
-		update();
+		requestRender();
 	}
 }
\ No newline at end of file
@@ -20,6 +20,8 @@
 #define FWE_EVDS_GLSCENE_H
 
 #include <QProgressDialog>
+#include <QTimer>
+#include <QTime>
 #include <QGLWidget>
 #include <QGLShader>
 #include <QGLFramebufferObject>
@@ -52,6 +54,25 @@ namespace EVDS {
 
 		void setCutsectionPlane(int plane, bool active);
 
+		//Scene contents have changed, schedule a redraw
+		void invalidate();
+
+		//Make OpenGL context of the view current
+		void makeCurrent();
+		//Get screenshot size from settings
+		void getScreenshotSize(int* width, int* height);
+		//Render view into an image of given size
+		QImage renderScreenshot(int width, int height);
+		//Export all schematics sheets into folder, returns number of sheets written
+		int exportSheets(const QString& outputPath, int* sheets_failed = 0);
+
+		//Get size of instance on screen relative to view height (0 if outside of view)
+		double getScreenFraction(GLC_3DViewInstance* instance);
+		//Get size of sphere on screen relative to view height (0 if outside of view)
+		double getScreenFraction(const GLC_Point3d& center, double radius);
+		//Check if instance is inside of the view
+		bool isInView(GLC_3DViewInstance* instance);
+
 	protected:
 		void geometryChanged(const QRectF &rect);
 		void drawBackground(QPainter *painter, const QRectF &rect);
@@ -76,9 +97,25 @@ namespace EVDS {
 
 		void cutsectionUpdated();
 
+		//Schedule a redraw if camera or overlay state has changed
+		void requestRender();
+
 	private:
+		//Schedule a redraw (limited to interactive frame rate while moving)
+		void scheduleRender();
+		//Check if camera, scene or overlay changed since last frame
+		bool isRenderStateChanged();
+		//Remember state of the last rendered frame
+		void saveRenderState();
+		//Get bitmask of the overlay state
+		int getOverlayState();
+		//Adjust level of detail used while moving to match the target frame time
+		void adjustInteractiveQuality(int frame_time);
+		//Project bounding sphere on screen, returns false if it's outside of the view
+		bool projectSphere(const GLC_Point3d& center, double radius, double* fraction);
+
 		//Save a single snapshot of a sheet
-		void saveCurrentSheet(const QString& baseFilename);
+		bool saveCurrentSheet(const QString& baseFilename);
 		//Create panels and interface
 		void createInterface();
 		//Recursively GLC-select object and its children
@@ -125,6 +162,19 @@ namespace EVDS {
 		bool makingScreenshot;
 		QRectF previousRect;
 
+		//Render scheduling
+		QTimer renderTimer;
+		QTime lastFrameTime;
+		int sceneGeneration;
+		int renderedGeneration;
+		int renderedOverlay;
+		Object* renderedSelection;
+		GLC_Matrix4x4 renderedCamera;
+		double renderedViewAngle;
+
+		//Minimum pixel culling size used in interactive quality mode
+		int interactiveCulling;
+
 		//Shaders and framebuffers
 		QGLFramebufferObject* fbo_outline;
 		QGLFramebufferObject* fbo_outline_selected;
@@ -174,8 +174,8 @@ void SchematicsEditor::selectObject(const QModelIndex& index) {
 		element_properties->setPropertySheet(getEditDocument()->getPropertySheet());
 		selected = NULL;
 
-		//Update information
-		updateObject(NULL);
+		//Redraw
+		glscene->requestRender();
 
 		//Update comments
 		disconnect(comments, SIGNAL(textChanged()), this, SLOT(commentsChanged()));
@@ -198,7 +198,7 @@ void SchematicsEditor::selectObject(const QModelIndex& index) {
 
 	//Get currently selected schematics sheet
 	sheet = object;
-	while (sheet && (sheet->getType() != "foxworks.schematics.sheet")) {
+	while (sheet && (sheet->getTypeId() != Object::TYPE_SCHEMATICS_SHEET)) {
 		sheet = sheet->getParent();
 		if (sheet == root) sheet = NULL;
 	}
@@ -213,8 +213,8 @@ void SchematicsEditor::selectObject(const QModelIndex& index) {
 	comments->setText(object->getString("text"));
 	connect(comments, SIGNAL(textChanged()), this, SLOT(commentsChanged()));
 
-	//Redraw
-	updateObject(NULL);
+	//Redraw (instances were already updated if sheet has changed)
+	glscene->requestRender();
 }
 
 
@@ -226,7 +226,6 @@ void SchematicsEditor::updateObject(Object* object) {
 		elements_list->getModel()->updateObject(object);
 	}
 	rendering_manager->updateInstances();
-	glscene->update();
 }
 
 
@@ -247,7 +246,7 @@ void SchematicsEditor::finishInitializing() {
 	Object* document = getEditDocument();
 	root = NULL;
 	for (int i = 0; i < document->getChildrenCount(); i++) {
-		if (document->getChild(i)->getType() == "foxworks.schematics") {
+		if (document->getChild(i)->getTypeId() == Object::TYPE_SCHEMATICS) {
 			root = document->getChild(i);
 			break;
 		}
@@ -258,6 +257,7 @@ void SchematicsEditor::finishInitializing() {
 		root = document->insertNewChild(0);
 		root->setType("foxworks.schematics");
 		root->setName("");
+		getEditorWindow()->objectInserted(root);
 	}
 
 	//Create schematics editor itself
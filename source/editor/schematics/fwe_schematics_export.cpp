@@ -0,0 +1,222 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QtEndian>
+#include "fwe_schematics_export.h"
+
+using namespace EVDS;
+
+//Maximum number of strips waiting to be encoded
+#define FWE_EXPORT_MAX_QUEUED_STRIPS	2
+//Size of a single IDAT chunk
+#define FWE_EXPORT_CHUNK_SIZE			65536
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Streaming PNG writer, encodes image strips in a separate thread
+////////////////////////////////////////////////////////////////////////////////
+SheetImageWriter::SheetImageWriter(const QString& fileName, int in_width, int in_height) : file(fileName) {
+	width = in_width;
+	height = in_height;
+	rowsWritten = 0;
+	compressedLength = 0;
+
+	queueFinished = false;
+	writeError = false;
+	memset(&stream,0,sizeof(stream));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+SheetImageWriter::~SheetImageWriter() {
+	if (isRunning()) finish();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write PNG signature and header, start encoding thread
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::open() {
+	if (!file.open(QIODevice::WriteOnly)) return false;
+	if (deflateInit(&stream,Z_DEFAULT_COMPRESSION) != Z_OK) {
+		file.close();
+		return false;
+	}
+
+	//PNG signature
+	static const char signature[8] = { (char)137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	file.write(signature,8);
+
+	//Image header (8-bit truecolor, no interlacing)
+	char header[13];
+	qToBigEndian<quint32>(width,(uchar*)&header[0]);
+	qToBigEndian<quint32>(height,(uchar*)&header[4]);
+	header[8] = 8;
+	header[9] = 2;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	if (!writeChunk("IHDR",header,13)) {
+		deflateEnd(&stream);
+		file.close();
+		return false;
+	}
+
+	//Allocate buffers and start thread
+	scanline.resize(1+width*3);
+	compressed.resize(FWE_EXPORT_CHUNK_SIZE);
+	start();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Queue rows for encoding. Blocks while too many strips are waiting
+////////////////////////////////////////////////////////////////////////////////
+void SheetImageWriter::writeStrip(const QByteArray& rows) {
+	queueLock.lock();
+		while (queue.count() >= FWE_EXPORT_MAX_QUEUED_STRIPS) {
+			queueNotFull.wait(&queueLock);
+		}
+		queue.enqueue(rows);
+		queueNotEmpty.wakeOne();
+	queueLock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Finish writing. Incomplete files are removed
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::finish() {
+	queueLock.lock();
+		queueFinished = true;
+		queueNotEmpty.wakeOne();
+	queueLock.unlock();
+	wait();
+
+	if (writeError || (rowsWritten != height)) {
+		file.remove();
+		return false;
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void SheetImageWriter::run() {
+	while (true) {
+		queueLock.lock();
+		while (queue.isEmpty() && (!queueFinished)) {
+			queueNotEmpty.wait(&queueLock);
+		}
+		if (queue.isEmpty()) {
+			queueLock.unlock();
+			break;
+		}
+		QByteArray rows = queue.dequeue();
+		queueNotFull.wakeOne();
+		queueLock.unlock();
+
+		if (!writeError) writeError = !encodeStrip(rows,false);
+	}
+
+	//Flush compressed stream and finish the file
+	if (!writeError) writeError = !encodeStrip(QByteArray(),true);
+	if (!writeError) writeError = !writeChunk("IEND",0,0);
+	deflateEnd(&stream);
+	file.close();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Convert RGBA rows into PNG scanlines and compress them
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::encodeStrip(const QByteArray& rows, bool last) {
+	int rowCount = rows.size() / (width*4);
+	if (rowsWritten + rowCount > height) rowCount = height - rowsWritten;
+
+	for (int row = 0; row <= rowCount; row++) {
+		bool flush = (row == rowCount);
+		if (flush && (!last)) break;
+
+		if (!flush) {
+			const uchar* src = (const uchar*)rows.constData() + row*width*4;
+			uchar* dest = (uchar*)scanline.data();
+			dest[0] = 0; //No filtering
+			for (int x = 0; x < width; x++) {
+				dest[1+x*3+0] = src[x*4+0];
+				dest[1+x*3+1] = src[x*4+1];
+				dest[1+x*3+2] = src[x*4+2];
+			}
+			stream.next_in = (Bytef*)scanline.data();
+			stream.avail_in = scanline.size();
+			rowsWritten++;
+		} else {
+			stream.next_in = 0;
+			stream.avail_in = 0;
+		}
+
+		//Compress and write out every full chunk
+		int result;
+		do {
+			stream.next_out = (Bytef*)compressed.data() + compressedLength;
+			stream.avail_out = compressed.size() - compressedLength;
+			result = deflate(&stream,flush ? Z_FINISH : Z_NO_FLUSH);
+			if (result == Z_STREAM_ERROR) return false;
+
+			compressedLength = compressed.size() - stream.avail_out;
+			if (compressedLength == compressed.size()) {
+				if (!writeChunk("IDAT",compressed.constData(),compressedLength)) return false;
+				compressedLength = 0;
+			}
+		} while ((stream.avail_in > 0) || (flush && (result != Z_STREAM_END)));
+
+		//Write out the remaining data
+		if (flush && (compressedLength > 0)) {
+			if (!writeChunk("IDAT",compressed.constData(),compressedLength)) return false;
+			compressedLength = 0;
+		}
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::writeChunk(const char* type, const char* data, int length) {
+	uchar length_be[4];
+	uchar crc_be[4];
+
+	//Checksum is calculated over type and data
+	uLong crc = crc32(0L,Z_NULL,0);
+	crc = crc32(crc,(const Bytef*)type,4);
+	if (length > 0) crc = crc32(crc,(const Bytef*)data,length);
+
+	qToBigEndian<quint32>(length,length_be);
+	qToBigEndian<quint32>(crc,crc_be);
+	if (file.write((const char*)length_be,4) != 4) return false;
+	if (file.write(type,4) != 4) return false;
+	if ((length > 0) && (file.write(data,length) != length)) return false;
+	if (file.write((const char*)crc_be,4) != 4) return false;
+	return true;
+}
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_SCHEMATICS_EXPORT_H
+#define FWE_SCHEMATICS_EXPORT_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QByteArray>
+#include <QFile>
+
+#include "zlib.h"
+
+namespace EVDS {
+	class SheetImageWriter : public QThread {
+		Q_OBJECT
+
+	public:
+		SheetImageWriter(const QString& fileName, int in_width, int in_height);
+		~SheetImageWriter();
+
+		//Open file and start encoding thread
+		bool open();
+		//Queue a strip of RGBA rows (top to bottom). Blocks if encoder is falling behind
+		void writeStrip(const QByteArray& rows);
+		//Finish writing the file, returns false if anything has failed
+		bool finish();
+
+	protected:
+		void run();
+
+	private:
+		//Write PNG chunk with the given type and data
+		bool writeChunk(const char* type, const char* data, int length);
+		//Compress a single strip and write out the full IDAT chunks
+		bool encodeStrip(const QByteArray& rows, bool last);
+
+		QFile file;
+		int width;
+		int height;
+		int rowsWritten;
+
+		//Queue of strips waiting for the encoder
+		QMutex queueLock;
+		QWaitCondition queueNotEmpty;
+		QWaitCondition queueNotFull;
+		QQueue<QByteArray> queue;
+		bool queueFinished;
+		bool writeError;
+
+		//Compression state
+		z_stream stream;
+		QByteArray scanline;
+		QByteArray compressed;
+		int compressedLength;
+	};
+}
+
+#endif
@@ -23,9 +23,15 @@
 #include "fwe_evds_object.h"
 #include "fwe_evds_object_renderer.h"
 #include "fwe_evds_modifiers.h"
+#include "fwe_trace.h"
 
 using namespace EVDS;
 
+//Interned variable names
+static const VariableRef var_reference("reference");
+static const VariableRef var_scale("scale");
+static const VariableRef var_sheet_scale("sheet.scale");
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
@@ -57,6 +63,7 @@ SchematicsRenderingManager::~SchematicsRenderingManager() {
 void SchematicsRenderingManager::updateInstances() {
 	if (!schematics_editor->getActive()) return;
 	qDebug("SchematicsRenderingManager::updateInstances()");
+	FWE_TRACE("SchematicsRenderingManager::updateInstances");
 
 	GLScene* glview = schematics_editor->getGLScene();
 
@@ -78,7 +85,7 @@ void SchematicsRenderingManager::updateInstances() {
 	updatePositions();
 
 	//Update GL scene
-	glview->update();
+	glview->invalidate();
 }
 
 
@@ -88,6 +95,7 @@ void SchematicsRenderingManager::updateInstances() {
 void SchematicsRenderingManager::updatePositions() {
 	if (!schematics_editor->getActive()) return;
 	qDebug("SchematicsRenderingManager::updatePositions()");
+	FWE_TRACE("SchematicsRenderingManager::updatePositions");
 
 	//Set positions of all children
 	for (int i = 0; i < schematicsInstances.count(); i++) {
@@ -106,9 +114,9 @@ void SchematicsRenderingManager::processUpdateInstances(Object* element) {
 	}
 
 	//Create instances for object elements
-	if (element->getType() == "foxworks.schematics.element") {
+	if (element->getTypeId() == Object::TYPE_SCHEMATICS_ELEMENT) {
 		EVDS_OBJECT* evds_object = 0;
-		QString reference = element->getString("reference");
+		QString reference = element->getString(var_reference);
 
 		if (reference != "") {
 			//EVDS_SYSTEM* system;
@@ -119,7 +127,8 @@ void SchematicsRenderingManager::processUpdateInstances(Object* element) {
 			if (evds_object) {
 				Object* object;
 				EVDS_Object_GetUserdata(evds_object,(void**)&object);
-				if (object != schematics_editor->getEVDSEditor()->getEditRoot()) {
+				//Objects inside collapsed subtrees are skipped until they are created
+				if (object && (object != schematics_editor->getEVDSEditor()->getEditRoot())) {
 					createInstance(element,object,true);
 				}
 			}
@@ -133,10 +142,10 @@ void SchematicsRenderingManager::processUpdateInstances(Object* element) {
 ////////////////////////////////////////////////////////////////////////////////
 GLC_Matrix4x4 SchematicsRenderingManager::getTransformationMatrix(Object* element) {
 	//Calculate scale
-	double scale = element->getVariable("scale");
+	double scale = element->getVariable(var_scale);
 	if (scale <= 0.0) {
 		//if (firstRecursive) { //Use default scale for firstmost object
-			scale = schematics_editor->getCurrentSheet()->getVariable("sheet.scale");
+			scale = schematics_editor->getCurrentSheet()->getVariable(var_sheet_scale);
 			if (scale <= 0.0) scale = 1.0;
 		//} else { //No scaling change
 			//scale = 1.0;
@@ -156,7 +165,7 @@ GLC_Matrix4x4 SchematicsRenderingManager::getTransformationMatrix(Object* elemen
 
 	transformation = transformation*GLC_Matrix4x4(vector.position.x,vector.position.y,vector.position.z);
 	transformation = transformation*GLC_Matrix4x4(rotationMatrix);
-	if (element->getParent() && (element->getParent()->getType() != "foxworks.schematics.sheet")) {
+	if (element->getParent() && (element->getParent()->getTypeId() != Object::TYPE_SCHEMATICS_SHEET)) {
 		transformation = transformation*getTransformationMatrix(element->getParent());
 	} else {
 		transformation = transformation*scaling; //First operation is scaling
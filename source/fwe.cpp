@@ -20,10 +20,12 @@
 #include <QFile>
 #include <QSettings>
 #include <QFontDatabase>
+#include <QStringList>
 //#include <QCleanlooksStyle>
 
 #include "fwe.h"
 #include "fwe_main.h"
+#include "fwe_trace.h"
 
 QApplication* fw_application;		/// FoxWorks application
 FWE::MainWindow* fw_mainWindow;		/// FoxWorks main window
@@ -71,6 +73,9 @@ void fw_editor_initialize(int flags, int argc, char *argv[]) {
 
 		fw_editor_settings = new QSettings("settings.ini",QSettings::IniFormat);
 		fw_mainWindow = new FWE::MainWindow(); //Show main window
+		if (flags & FOXWORKS_EDITOR_HEADLESS) {
+			fw_mainWindow->setAttribute(Qt::WA_DontShowOnScreen);
+		}
 		fw_mainWindow->show();
 
 		//Load default fonts
@@ -110,7 +115,98 @@ void fw_editor_frame() {
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Main call (used when compiling standalone)
+///
+/// Batch rendering of screenshots and schematics sheets without a visible window:
+///
+///		foxworks_editor --render [--output <path>] <file.evds> [<file.evds> ...]
+///
+/// OpenGL context is still required. On machines without GPU run it under a
+/// virtual X server with software rendering (for example Xvfb with Mesa llvmpipe).
+///
+/// Timings of the editor pipeline are written as JSON (default "benchmark.json"):
+///
+///		foxworks_editor --benchmark [--output <file.json>] <file.evds> [<file.evds> ...]
+///
+/// The foxworks_benchmark build always runs the benchmark. It only counts allocations
+/// when it is built with the premake "--count-allocations" option.
+///
+/// Synthetic vessels for scaling tests are generated with (defaults are shown):
+///
+///		foxworks_editor --generate [--depth 4] [--fanout 8] [--modifiers 4]
+///			[--modifier-depth 1] [--sections 4] [--sheets 2] [--output generated.evds]
+///
+/// The vessel has "depth" levels of assemblies with "fanout" children each, fuel
+/// tanks with "sections" cross-sections on the last level, "modifiers" chains of
+/// "modifier-depth" nested modifiers and schematics sheets referencing objects
+/// spread over the entire vessel.
+///
+/// Any mode accepts "--trace <file.json>" to write spans of the editor pipeline as
+/// Chrome trace on exit (only in builds made with the premake "--tracing" option).
 ////////////////////////////////////////////////////////////////////////////////
 int main(int argc, char *argv[]) {
-	fw_editor_initialize(FOXWORKS_EDITOR_STANDALONE | FOXWORKS_EDITOR_BLOCKING,argc,argv);
+	QStringList files;
+	QString outputPath;
+	bool headless = false;
+	bool generate = false;
+	QString traceFile;
+	int depth = 4;
+	int fanout = 8;
+	int modifiers = 4;
+	int modifierDepth = 1;
+	int sections = 4;
+	int sheets = 2;
+#ifdef FWE_BENCHMARK
+	bool benchmark = true;
+#else
+	bool benchmark = false;
+#endif
+	for (int i = 1; i < argc; i++) {
+		QString arg = QString::fromLocal8Bit(argv[i]);
+		if (arg == "--render") {
+			headless = true;
+		} else if (arg == "--benchmark") {
+			benchmark = true;
+		} else if (arg == "--generate") {
+			generate = true;
+		} else if ((arg == "--depth") && (i+1 < argc)) {
+			depth = QString::fromLocal8Bit(argv[++i]).toInt();
+		} else if ((arg == "--fanout") && (i+1 < argc)) {
+			fanout = QString::fromLocal8Bit(argv[++i]).toInt();
+		} else if ((arg == "--modifiers") && (i+1 < argc)) {
+			modifiers = QString::fromLocal8Bit(argv[++i]).toInt();
+		} else if ((arg == "--modifier-depth") && (i+1 < argc)) {
+			modifierDepth = QString::fromLocal8Bit(argv[++i]).toInt();
+		} else if ((arg == "--sections") && (i+1 < argc)) {
+			sections = QString::fromLocal8Bit(argv[++i]).toInt();
+		} else if ((arg == "--sheets") && (i+1 < argc)) {
+			sheets = QString::fromLocal8Bit(argv[++i]).toInt();
+		} else if ((arg == "--trace") && (i+1 < argc)) {
+			traceFile = QString::fromLocal8Bit(argv[++i]);
+		} else if ((arg == "--output") && (i+1 < argc)) {
+			outputPath = QString::fromLocal8Bit(argv[++i]);
+		} else if (!arg.startsWith("-")) {
+			files.append(arg);
+		}
+	}
+
+	if ((!headless) && (!benchmark) && (!generate)) {
+		fw_editor_initialize(FOXWORKS_EDITOR_STANDALONE | FOXWORKS_EDITOR_BLOCKING,argc,argv);
+		if (!traceFile.isEmpty()) FWE::Trace::exportChromeTrace(traceFile);
+		return 0;
+	}
+
+	fw_editor_initialize(FOXWORKS_EDITOR_STANDALONE | FOXWORKS_EDITOR_HEADLESS,argc,argv);
+	int failed;
+	if (generate) {
+		failed = fw_mainWindow->generateFile(outputPath.isEmpty() ? "generated.evds" : outputPath,
+			depth,fanout,modifiers,modifierDepth,sections,sheets);
+	} else if (benchmark) {
+		failed = fw_mainWindow->benchmarkFiles(files,outputPath.isEmpty() ? "benchmark.json" : outputPath);
+	} else {
+		failed = fw_mainWindow->renderFiles(files,outputPath.isEmpty() ? "." : outputPath);
+	}
+	if (!traceFile.isEmpty()) FWE::Trace::exportChromeTrace(traceFile);
+	delete fw_mainWindow;
+	fw_editor_deinitialize();
+	return (failed > 0) ? 1 : 0;
 }
\ No newline at end of file
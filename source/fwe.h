@@ -26,6 +26,8 @@ extern "C" {
 #define FOXWORKS_EDITOR_STANDALONE		1
 /// Execute editor in a different thread
 #define FOXWORKS_EDITOR_BLOCKING		2
+/// Run without a visible window (batch rendering from command line)
+#define FOXWORKS_EDITOR_HEADLESS		4
 
 void fw_editor_initialize(int flags, int argc, char *argv[]);
 void fw_editor_deinitialize();
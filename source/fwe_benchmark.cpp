@@ -0,0 +1,295 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QtGui>
+#include <new>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "fwe.h"
+#include "fwe_main.h"
+#include "fwe_editor.h"
+#include "fwe_evds.h"
+#include "fwe_evds_object.h"
+#include "fwe_evds_object_renderer.h"
+#include "fwe_evds_modifiers.h"
+
+using namespace FWE;
+
+//Exception specifications of replaced operators (must match declarations in <new>)
+#if __cplusplus >= 201103L
+#define FWE_BENCHMARK_NOEXCEPT noexcept
+#define FWE_BENCHMARK_THROWS
+#else
+#define FWE_BENCHMARK_NOEXCEPT throw()
+#define FWE_BENCHMARK_THROWS throw(std::bad_alloc)
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Allocation counters. Global allocation operators are only replaced when the
+/// benchmark is built with "--count-allocations" (FWE_BENCHMARK_ALLOCATIONS), so
+/// timings of a regular benchmark build are not affected. Memory allocated by the
+/// C libraries (EVDS, SIMC) is not counted.
+////////////////////////////////////////////////////////////////////////////////
+#ifdef FWE_BENCHMARK_ALLOCATIONS
+static QAtomicInt fw_benchmark_allocations;
+
+void* operator new(size_t size) FWE_BENCHMARK_THROWS {
+	fw_benchmark_allocations.ref();
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+void* operator new[](size_t size) FWE_BENCHMARK_THROWS {
+	fw_benchmark_allocations.ref();
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+void* operator new(size_t size, const std::nothrow_t&) FWE_BENCHMARK_NOEXCEPT {
+	fw_benchmark_allocations.ref();
+	return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) FWE_BENCHMARK_NOEXCEPT {
+	fw_benchmark_allocations.ref();
+	return malloc(size ? size : 1);
+}
+void operator delete(void* ptr) FWE_BENCHMARK_NOEXCEPT { free(ptr); }
+void operator delete[](void* ptr) FWE_BENCHMARK_NOEXCEPT { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) FWE_BENCHMARK_NOEXCEPT { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) FWE_BENCHMARK_NOEXCEPT { free(ptr); }
+
+static int FWE_Benchmark_GetAllocations() { return (int)fw_benchmark_allocations; }
+#else
+static int FWE_Benchmark_GetAllocations() { return -1; }
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get peak resident memory of the process in kilobytes
+////////////////////////////////////////////////////////////////////////////////
+static qint64 FWE_Benchmark_GetPeakRSS() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(),&counters,sizeof(counters))) return -1;
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF,&usage) != 0) return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; //Reported in bytes
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count objects in EVDS hierarchy
+////////////////////////////////////////////////////////////////////////////////
+static int FWE_Benchmark_CountObjects(EVDS_OBJECT* object) {
+	int count = 1;
+
+	SIMC_LIST* list;
+	EVDS_Object_GetAllChildren(object,&list);
+	SIMC_LIST_ENTRY* entry = SIMC_List_GetFirst(list);
+	while (entry) {
+		count += FWE_Benchmark_CountObjects((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		entry = SIMC_List_GetNext(list,entry);
+	}
+	return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Request new meshes for all objects
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_Benchmark_RebuildMeshes(EVDS::Object* object) {
+	if (object->getRenderer()) object->getRenderer()->meshChanged();
+	for (int i = 0; i < object->getChildrenCount(); i++) {
+		FWE_Benchmark_RebuildMeshes(object->getChild(i));
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Measures a single phase of the benchmark
+////////////////////////////////////////////////////////////////////////////////
+namespace FWE {
+	class BenchmarkPhase {
+	public:
+		BenchmarkPhase(QTextStream* in_json, const QString& in_name, bool in_last = false) {
+			json = in_json;
+			name = in_name;
+			last = in_last;
+			allocations = FWE_Benchmark_GetAllocations();
+			measuredTime = -1;
+			time.start();
+		}
+		~BenchmarkPhase();
+
+		//Report time measured by the phase itself instead of the time spent waiting for it
+		void setTime(int msec) { measuredTime = msec; }
+
+	private:
+		QTextStream* json;
+		QString name;
+		bool last;
+		int allocations;
+		int measuredTime;
+		QTime time;
+	};
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write results of the phase
+////////////////////////////////////////////////////////////////////////////////
+BenchmarkPhase::~BenchmarkPhase() {
+	int elapsed = (measuredTime >= 0) ? measuredTime : time.elapsed();
+	int phase_allocations = -1;
+	if (allocations >= 0) phase_allocations = FWE_Benchmark_GetAllocations() - allocations;
+
+	*json << "\t\t\t\t\"" << name << "\": { ";
+	*json << "\"time_ms\": " << elapsed << ", ";
+	*json << "\"allocations\": " << phase_allocations << ", ";
+	*json << "\"peak_rss_kb\": " << FWE_Benchmark_GetPeakRSS() << " }";
+	*json << (last ? "\n" : ",\n");
+	qDebug("MainWindow::benchmarkFiles: %s: %d msec",name.toUtf8().data(),elapsed);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Measure time taken by every stage of the editor pipeline for each file.
+///
+/// Results are written as JSON into the output file. Phases are:
+///  - "load": reading the file and creating objects
+///  - "meshes": generating meshes and LODs for all objects after loading
+///  - "mesh_rebuild": generating all meshes and LODs again
+///  - "initializer": initializing and solving the copy of the vessel (as measured
+///    by the initializer thread, without waiting for it to pick up the update)
+///  - "modifiers": rebuilding instances created by all modifiers
+///  - "save": writing the file
+////////////////////////////////////////////////////////////////////////////////
+int MainWindow::benchmarkFiles(const QStringList& files, const QString& outputFile) {
+	QFile output(outputFile);
+	if (!output.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		qWarning("MainWindow::benchmarkFiles: cannot write %s",outputFile.toUtf8().data());
+		return files.count();
+	}
+	QTextStream json(&output);
+	json << "{\n";
+	json << "\t\"allocations_counted\": " << ((FWE_Benchmark_GetAllocations() >= 0) ? "true" : "false") << ",\n";
+	json << "\t\"files\": [\n";
+
+	int failed_loads = 0;
+	int mesh_timeouts = 0;
+	int failed_saves = 0;
+	for (int i = 0; i < files.count(); i++) {
+		QFileInfo fileInfo(files[i]);
+		qDebug("MainWindow::benchmarkFiles: benchmarking %s (%d/%d)",
+			fileInfo.fileName().toUtf8().data(),i+1,files.count());
+
+		QString fileName = fileInfo.absoluteFilePath();
+		fileName.replace("\\","\\\\").replace("\"","\\\"");
+		json << "\t\t{\n";
+		json << "\t\t\t\"file\": \"" << fileName << "\",\n";
+		json << "\t\t\t\"phases\": {\n";
+
+		//Read file and create objects
+		EditorWindow* child = createMdiChild();
+		bool loaded;
+		{
+			BenchmarkPhase phase(&json,"load");
+			loaded = child->loadFile(files[i]);
+			if (!loaded) child->close();
+			loaded = loaded && waitForLoading(child); //Editor closes itself if reading fails
+		}
+		if (!loaded) {
+			json << "\t\t\t\t\"failed\": true\n";
+			json << "\t\t\t}\n";
+			json << ((i < files.count()-1) ? "\t\t},\n" : "\t\t}\n");
+			failed_loads++;
+			continue;
+		}
+		child->showMaximized();
+		EVDS::Editor* editor = child->getEVDSEditor();
+
+		//Generate meshes queued while loading, then all of them again
+		{
+			BenchmarkPhase phase(&json,"meshes");
+			if (!waitForMeshes(FWE_EDITOR_MESH_TIMEOUT)) mesh_timeouts++;
+		}
+		{
+			BenchmarkPhase phase(&json,"mesh_rebuild");
+			FWE_Benchmark_RebuildMeshes(child->getEditRoot());
+			if (!waitForMeshes(FWE_EDITOR_MESH_TIMEOUT)) mesh_timeouts++;
+		}
+
+		//Initialize and solve copy of the vessel (waits until the initializer thread is done)
+		{
+			BenchmarkPhase phase(&json,"initializer");
+			editor->getInitializer()->doUpdateObject();
+			delete editor->getInitializer()->getObject(child->getEditRoot());
+			phase.setTime(editor->getInitializer()->getLastSolveTime());
+		}
+
+		//Rebuild modifiers right away instead of on the next timer tick
+		{
+			BenchmarkPhase phase(&json,"modifiers");
+			editor->getModifiersManager()->updateModifiers();
+			QMetaObject::invokeMethod(editor->getModifiersManager(),"doUpdateModifiers",Qt::DirectConnection);
+		}
+
+		//Write a copy of the file (same format as the original)
+		QString saveFile = QDir::temp().filePath("fwe_benchmark." + fileInfo.suffix());
+		{
+			BenchmarkPhase phase(&json,"save",true);
+			if (!child->saveFile(saveFile,true)) failed_saves++;
+		}
+		QFile::remove(saveFile);
+
+		json << "\t\t\t},\n";
+		json << "\t\t\t\"objects\": " << FWE_Benchmark_CountObjects(child->getEditRoot()->getEVDSObject()) << "\n";
+		json << ((i < files.count()-1) ? "\t\t},\n" : "\t\t}\n");
+
+		//Close editor and let it clean up
+		child->close();
+		QApplication::processEvents();
+	}
+
+	json << "\t],\n";
+	json << "\t\"failed_loads\": " << failed_loads << ",\n";
+	json << "\t\"mesh_timeouts\": " << mesh_timeouts << ",\n";
+	json << "\t\"failed_saves\": " << failed_saves << ",\n";
+	json << "\t\"peak_rss_kb\": " << FWE_Benchmark_GetPeakRSS() << "\n";
+	json << "}\n";
+	if (mesh_timeouts > 0) {
+		qWarning("MainWindow::benchmarkFiles: meshes were not generated in time %d times",mesh_timeouts);
+	}
+	return failed_loads + mesh_timeouts + failed_saves;
+}
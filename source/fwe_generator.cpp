@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QtGui>
+#include <math.h>
+
+#include "fwe.h"
+#include "fwe_main.h"
+#include "fwe_editor.h"
+#include "fwe_evds.h"
+#include "fwe_evds_object.h"
+#include "fwe_evds_residency.h"
+#include "fwe_schematics.h"
+
+using namespace FWE;
+
+//Number of copies made by every generated modifier
+#define FWE_GENERATOR_MODIFIER_COPIES	8
+//Number of elements placed on a single schematics sheet
+#define FWE_GENERATOR_SHEET_ELEMENTS	24
+//Distance between neighbouring objects of the same level
+#define FWE_GENERATOR_SPACING			2.0
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Set position of an object (its property sheet may not exist yet)
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_Generator_SetPosition(EVDS::Object* object, double x, double y, double z) {
+	EVDS_STATE_VECTOR vector;
+	EVDS_Object_GetStateVector(object->getEVDSObject(),&vector);
+	vector.position.x = x;
+	vector.position.y = y;
+	vector.position.z = z;
+	EVDS_Object_SetStateVector(object->getEVDSObject(),&vector);
+	object->update(false);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Add elliptic cross-sections to the geometry of a fuel tank
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_Generator_AddCrossSections(EVDS::Object* object, int sections) {
+	EVDS_VARIABLE* geometry;
+	EVDS_Object_AddVariable(object->getEVDSObject(),"geometry.cross_sections",EVDS_VARIABLE_TYPE_NESTED,&geometry);
+
+	for (int i = 0; i < sections; i++) {
+		EVDS_VARIABLE* csection;
+		EVDS_VARIABLE* attribute;
+		EVDS_Variable_AddNested(geometry,"section",EVDS_VARIABLE_TYPE_NESTED,&csection);
+		EVDS_Variable_AddAttribute(csection,"type",EVDS_VARIABLE_TYPE_STRING,&attribute);
+		EVDS_Variable_SetString(attribute,"ellipse",8);
+		EVDS_Variable_AddAttribute(csection,"offset",EVDS_VARIABLE_TYPE_FLOAT,&attribute);
+		EVDS_Variable_SetReal(attribute,(i > 0) ? 0.5 : 0.0);
+
+		//Bulge in the middle so every section produces distinct geometry
+		double radius = 0.4 + 0.2*sin(3.1415926*i/qMax(1,sections-1));
+		EVDS_Variable_AddAttribute(csection,"rx",EVDS_VARIABLE_TYPE_FLOAT,&attribute);
+		EVDS_Variable_SetReal(attribute,radius);
+		EVDS_Variable_AddAttribute(csection,"ry",EVDS_VARIABLE_TYPE_FLOAT,&attribute);
+		EVDS_Variable_SetReal(attribute,radius);
+	}
+	object->invalidateVariables();
+	object->update(true);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create new fuel tank with cross-sections
+////////////////////////////////////////////////////////////////////////////////
+static EVDS::Object* FWE_Generator_CreateTank(EVDS::Object* parent, const QString& name, int sections) {
+	EVDS::Object* object = parent->insertNewChild(parent->getChildrenCount());
+	object->setName(name);
+	object->setType("fuel_tank");
+	object->setVariable("fuel.mass",100.0);
+	FWE_Generator_AddCrossSections(object,sections);
+	return object;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Recursively create a level of the generated hierarchy
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_Generator_CreateLevel(EVDS::Object* parent, const QString& name, int depth, int fanout,
+									  int sections, QList<EVDS::Object*>* objects) {
+	for (int i = 0; i < fanout; i++) {
+		QString child_name = QString("%1.%2").arg(name).arg(i+1);
+		EVDS::Object* child;
+		if (depth > 1) {
+			child = parent->insertNewChild(parent->getChildrenCount());
+			child->setName(QString("Assembly %1").arg(child_name));
+			objects->append(child);
+			FWE_Generator_CreateLevel(child,child_name,depth-1,fanout,sections,objects);
+		} else {
+			child = FWE_Generator_CreateTank(parent,QString("Tank %1").arg(child_name),sections);
+			objects->append(child);
+		}
+
+		//Objects are laid out in a row along the axis of the level
+		double offset = (i - 0.5*(fanout-1))*FWE_GENERATOR_SPACING*depth;
+		FWE_Generator_SetPosition(child,(depth % 2) ? offset : 0.0,(depth % 2) ? 0.0 : offset,0.0);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create circular modifier with a chain of nested modifiers inside of it.
+///  The innermost modifier makes copies of its own fuel tank.
+////////////////////////////////////////////////////////////////////////////////
+static EVDS::Object* FWE_Generator_CreateModifier(EVDS::Object* parent, const QString& name, int depth,
+												  int sections, QList<EVDS::Object*>* objects) {
+	EVDS::Object* modifier = parent->insertNewChild(parent->getChildrenCount());
+	modifier->setName(QString("Modifier %1").arg(name));
+	modifier->setType("modifier");
+	modifier->setVariable("pattern","circular");
+	modifier->setVariable("vector1.count",FWE_GENERATOR_MODIFIER_COPIES);
+	modifier->setVariable("circular.radius",2.0);
+	objects->append(modifier);
+
+	EVDS::Object* child;
+	if (depth > 1) {
+		child = FWE_Generator_CreateModifier(modifier,name + ".1",depth-1,sections,objects);
+	} else {
+		child = FWE_Generator_CreateTank(modifier,QString("Modified tank %1").arg(name),sections);
+		objects->append(child);
+	}
+	FWE_Generator_SetPosition(child,0.0,1.0,0.0);
+	return modifier;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Generate a synthetic vessel and write it into a file.
+///
+/// The document is built through the same object API the user interface uses:
+///  - a vessel with "depth" levels of assemblies, every one of which has "fanout"
+///    children. The last level consists of fuel tanks with "sections" cross-sections
+///  - "modifiers" circular modifiers. Every one holds a chain of "modifierDepth"
+///    nested modifiers, the innermost one making copies of its own fuel tank (so
+///    there are FWE_GENERATOR_MODIFIER_COPIES^modifierDepth copies of every tank)
+///  - "sheets" schematics sheets with elements referencing generated objects. If
+///    there are more objects than elements, references are spread evenly over all
+///    of them
+///
+/// Returns number of failures (0 or 1).
+////////////////////////////////////////////////////////////////////////////////
+int MainWindow::generateFile(const QString& outputFile, int depth, int fanout, int modifiers, int modifierDepth,
+							 int sections, int sheets) {
+	qDebug("MainWindow::generateFile: generating %s (depth %d, fanout %d, %d modifiers of depth %d, %d sections, %d sheets)",
+		outputFile.toUtf8().data(),depth,fanout,modifiers,modifierDepth,sections,sheets);
+
+	EditorWindow* child = createMdiChild();
+	child->newFile();
+
+	//Create all objects in a single batch, meshes are not needed for writing the file
+	QTime time;
+	time.start();
+	child->getEVDSEditor()->getResidencyManager()->setDeferMeshes(true);
+	child->beginBatchUpdate();
+
+	EVDS::Object* vessel = child->getEditRoot()->insertNewChild(child->getEditRoot()->getChildrenCount());
+	vessel->setName("Generated vessel");
+	vessel->setType("vessel");
+	child->objectInserted(vessel);
+
+	QList<EVDS::Object*> objects;
+	if (depth > 0) FWE_Generator_CreateLevel(vessel,"1",depth,qMax(1,fanout),sections,&objects);
+
+	//Modifiers are placed behind the vessel
+	for (int i = 0; i < modifiers; i++) {
+		EVDS::Object* modifier = FWE_Generator_CreateModifier(vessel,QString::number(i+1),qMax(1,modifierDepth),
+															  sections,&objects);
+		FWE_Generator_SetPosition(modifier,-FWE_GENERATOR_SPACING*(depth+i+1),0.0,0.0);
+	}
+
+	//Schematics sheets reference generated objects in order
+	EVDS::Object* schematics = child->getSchematicsEditor()->getMetadataRoot();
+	int elements = qMin(objects.count(),sheets*FWE_GENERATOR_SHEET_ELEMENTS);
+	char reference[8193] = { 0 };
+	for (int i = 0; i < sheets; i++) {
+		EVDS::Object* sheet = schematics->insertNewChild(schematics->getChildrenCount());
+		sheet->setName(QString("Sheet %1").arg(i+1));
+		sheet->setType("foxworks.schematics.sheet");
+		sheet->setVariable("paper.format","a3");
+		sheet->setVariable("sheet.number",i+1);
+		child->objectInserted(sheet);
+
+		for (int j = 0; j < FWE_GENERATOR_SHEET_ELEMENTS; j++) {
+			int element_index = i*FWE_GENERATOR_SHEET_ELEMENTS + j;
+			if (element_index >= elements) break;
+			int index = (int)(((qint64)element_index*objects.count())/elements);
+
+			EVDS::Object* element = sheet->insertNewChild(sheet->getChildrenCount());
+			element->setName(objects[index]->getName());
+			element->setType("foxworks.schematics.element");
+			EVDS_Object_GetReference(objects[index]->getEVDSObject(),child->getEditRoot()->getEVDSObject(),reference,8192);
+			element->setVariable("reference",QString(reference));
+			FWE_Generator_SetPosition(element,0.05*(j % 6),0.05*(j / 6),0.0);
+		}
+	}
+
+	child->endBatchUpdate();
+	qDebug("MainWindow::generateFile: created objects in %d msec",time.elapsed());
+
+	//Write file and close editor without asking to save it
+	bool saved = child->saveFile(outputFile);
+	child->getEVDSEditor()->getResidencyManager()->setDeferMeshes(false);
+	if (!saved) qWarning("MainWindow::generateFile: cannot write %s",outputFile.toUtf8().data());
+	child->close();
+	QApplication::processEvents();
+	return saved ? 0 : 1;
+}
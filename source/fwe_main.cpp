@@ -19,9 +19,13 @@
 #include <QtGui>
 #include <QIcon>
 
+#include "fwe.h"
 #include "fwe_main.h"
 #include "fwe_editor.h"
 #include "fwe_evds.h"
+#include "fwe_evds_object_renderer.h"
+#include "fwe_evds_residency.h"
+#include "fwe_glscene.h"
 #include "fwe_schematics.h"
 #include "fwe_dialog_preferences.h"
 #include "rdrs.h"
@@ -59,8 +63,22 @@ MainWindow::MainWindow() {
 		fw_editor_settings->value("rendering.use_fxaa",				true));
 	fw_editor_settings->setValue ("rendering.outline_thickness",			
 		fw_editor_settings->value("rendering.outline_thickness",	1.0));
+	fw_editor_settings->setValue ("rendering.interactive_fps",			
+		fw_editor_settings->value("rendering.interactive_fps",		30));
+	fw_editor_settings->setValue ("rendering.interactive_quality",			
+		fw_editor_settings->value("rendering.interactive_quality",	true));
+	fw_editor_settings->setValue ("rendering.interactive_frame_time",			
+		fw_editor_settings->value("rendering.interactive_frame_time",	33));
+	fw_editor_settings->setValue ("rendering.mesh_budget",			
+		fw_editor_settings->value("rendering.mesh_budget",			512));
+	fw_editor_settings->setValue ("rendering.mesh_cache_budget",			
+		fw_editor_settings->value("rendering.mesh_cache_budget",	256));
 	fw_editor_settings->setValue ("ui.autosave",					
 		fw_editor_settings->value("ui.autosave",					30000));
+	fw_editor_settings->setValue ("ui.journal_saves",					
+		fw_editor_settings->value("ui.journal_saves",				false));
+	fw_editor_settings->setValue ("ui.lazy_loading_objects",			
+		fw_editor_settings->value("ui.lazy_loading_objects",		5000));
 	fw_editor_settings->setValue ("screenshot.width",			
 		fw_editor_settings->value("screenshot.width",				2048));
 	fw_editor_settings->setValue ("screenshot.height",			
@@ -95,7 +113,8 @@ MainWindow::MainWindow() {
 	resize(fw_editor_settings->value("window.size", QSize(1024, 640)).toSize());
 
 
-	//Create new empty file or load some file right away
+	//Create new empty file or load some file right away (files are loaded separately in headless mode)
+	if (fw_editor_flags & FOXWORKS_EDITOR_HEADLESS) return;
 #ifdef _DEBUG
 	if (QFile::exists("bug_test_case.evds")) {
 		EditorWindow *child = createMdiChild();
@@ -493,4 +512,114 @@ EditorWindow *MainWindow::createMdiChild() {
 
 	updateInterface();
 	return child;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Render screenshot and all schematics sheets for every file.
+///
+/// Used in headless mode: each file is loaded into its own editor, and once all
+/// meshes are generated the results are written into "<outputPath>/<file name>/".
+////////////////////////////////////////////////////////////////////////////////
+int MainWindow::renderFiles(const QStringList& files, const QString& outputPath) {
+	int failed = 0;
+	for (int i = 0; i < files.count(); i++) {
+		QFileInfo fileInfo(files[i]);
+
+		EditorWindow* child = createMdiChild();
+		if (!child->loadFile(files[i])) {
+			child->close();
+			failed++;
+			continue;
+		}
+		child->showMaximized();
+
+		//File is read in background, editor closes itself if reading fails
+		if (!waitForLoading(child)) {
+			failed++;
+			continue;
+		}
+
+		//Meshes are generated in background
+		if (!waitForMeshes(FWE_EDITOR_MESH_TIMEOUT)) {
+			qWarning("MainWindow::renderFiles: timed out while generating meshes for %s",
+				fileInfo.fileName().toUtf8().data());
+		}
+
+		//Create folder for the results
+		QDir outputDir(outputPath);
+		if ((!outputDir.mkpath(fileInfo.completeBaseName())) || (!outputDir.cd(fileInfo.completeBaseName()))) {
+			qWarning("MainWindow::renderFiles: cannot create output folder for %s",
+				fileInfo.fileName().toUtf8().data());
+			child->close();
+			failed++;
+			continue;
+		}
+
+		//Render view of the vessel
+		EVDS::GLScene* glscene = child->getEVDSEditor()->getGLScene();
+		glscene->setIsoView();
+		glscene->doCenter();
+
+		int width,height;
+		glscene->getScreenshotSize(&width,&height);
+		QString screenshotFile = outputDir.filePath(fileInfo.completeBaseName() + ".png");
+		if (!glscene->renderScreenshot(width,height).save(screenshotFile)) {
+			qWarning("MainWindow::renderFiles: cannot save screenshot %s",screenshotFile.toUtf8().data());
+			failed++;
+		}
+
+		//Render schematics sheets
+		int sheets_failed;
+		child->getSchematicsEditor()->getGLScene()->exportSheets(outputDir.path(),&sheets_failed);
+		if (sheets_failed > 0) {
+			qWarning("MainWindow::renderFiles: cannot save %d sheets of %s",
+				sheets_failed,fileInfo.fileName().toUtf8().data());
+			failed++;
+		}
+
+		//Close editor and let it clean up
+		child->close();
+		QApplication::processEvents();
+	}
+	return failed;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Process events until file is read, returns false if editor was closed
+////////////////////////////////////////////////////////////////////////////////
+bool MainWindow::waitForLoading(EditorWindow* child) {
+	QPointer<EditorWindow> editor(child);
+	QEventLoop loop;
+	QTimer pollTimer;
+	connect(&pollTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
+	pollTimer.start(50);
+
+	while (editor && editor->isLoading()) {
+		loop.exec();
+	}
+	return editor && (!editor->isLoadingFailed());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Process events until all LOD meshes are generated
+////////////////////////////////////////////////////////////////////////////////
+bool MainWindow::waitForMeshes(int timeout) {
+	QEventLoop loop;
+	QTimer pollTimer;
+	connect(&pollTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
+	pollTimer.start(50);
+
+	//Mesh updates are requested with a delay, so always wait a little bit
+	QTime time;
+	time.start();
+	while ((time.elapsed() < 1000) ||
+		   (EVDS::ObjectLODGenerator::getPendingJobs() > 0) ||
+		   (EVDS::MeshResidencyManager::getTotalStatistics().queuedMeshes > 0)) {
+		if (time.elapsed() > timeout) return false;
+		loop.exec();
+	}
+	return true;
 }
\ No newline at end of file
@@ -36,6 +36,7 @@ QT_END_NAMESPACE
 extern QSettings* fw_editor_settings; //See fwe.cpp
 
 #define FWE_EDITOR_MAX_RECENT_FILES	10
+#define FWE_EDITOR_MESH_TIMEOUT		600000 //Maximum time to wait for meshes in headless mode (ms)
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +53,14 @@ namespace FWE {
 	public:
 		MainWindow();
 
+		//Render screenshots and sheets for files without user interaction (returns number of failures)
+		int renderFiles(const QStringList& files, const QString& outputPath);
+		//Measure loading, meshing, solving and saving of files, write results as JSON (returns number of failures)
+		int benchmarkFiles(const QStringList& files, const QString& outputFile);
+		//Generate a synthetic vessel of the given size and write it into file (returns number of failures)
+		int generateFile(const QString& outputFile, int depth, int fanout, int modifiers, int modifierDepth,
+						 int sections, int sheets);
+
 		//Get various public menus
 		QMenu* getFileMenu() { return fileMenu; }
 		QMenu* getEditMenu() { return editMenu; }
@@ -89,6 +98,11 @@ namespace FWE {
 		void createActionsMenus();
 		void createToolBars();
 
+		//Wait until file is read (returns false if it could not be read)
+		bool waitForLoading(EditorWindow* child);
+		//Wait until all meshes are generated (returns false on timeout)
+		bool waitForMeshes(int timeout);
+
 		//MDI area management
 		EditorWindow *activeMdiChild();
 		QMdiSubWindow *findMdiChild(const QString &fileName);
@@ -49,7 +49,7 @@ void MainWindow::fileOpen() {
 		//"FoxWorks Data Files (*.evds *.ivss);;"
 		//"External Vessel Dynamics Simulator (*.evds);;"
 		//"Internal Vessel Systems Simulator (*.ivss);;"
-		"External Vessel Dynamics Simulator Model (*.evds);;"
+		"External Vessel Dynamics Simulator Model (*.evds *.evdsb);;"
 		"All files (*.*)");
 
 	if (!fileName.isEmpty()) {
@@ -63,7 +63,7 @@ void MainWindow::fileOpen() {
 
 		EditorWindow *child = createMdiChild();
 		if (child->loadFile(fileName)) {
-			statusBar()->showMessage(tr("File loaded"), 2000);
+			statusBar()->showMessage(tr("Loading file..."), 2000);
 			child->show();
 		} else {
 			child->close();
@@ -87,7 +87,7 @@ void MainWindow::fileOpenRecent() {
 
 		EditorWindow *child = createMdiChild();
 		if (child->loadFile(action->data().toString())) {
-			statusBar()->showMessage(tr("File loaded"), 2000);
+			statusBar()->showMessage(tr("Loading file..."), 2000);
 			child->show();
 		} else {
 			child->close();
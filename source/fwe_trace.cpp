@@ -0,0 +1,246 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#include <QtCore>
+#include "fwe_trace.h"
+
+using namespace FWE;
+
+#ifdef FWE_TRACING
+//Number of spans each thread records before moving them into the ring buffer
+#define FWE_TRACE_THREAD_SPANS	256
+//Number of most recent spans kept in the ring buffer
+#define FWE_TRACE_RING_SPANS	262144
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Recorded span
+////////////////////////////////////////////////////////////////////////////////
+struct FWE_TraceSpan {
+	const char* name;
+	quint64 thread;
+	qint64 start;
+	qint64 duration;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Spans of a single thread. Only the owner thread appends spans, other threads
+/// may read first "count" spans while holding the trace lock.
+////////////////////////////////////////////////////////////////////////////////
+class FWE_TraceThreadBuffer {
+public:
+	FWE_TraceThreadBuffer();
+	~FWE_TraceThreadBuffer();
+
+	//Move spans into the ring buffer (trace lock must be held)
+	void flush();
+
+	FWE_TraceSpan spans[FWE_TRACE_THREAD_SPANS];
+	QAtomicInt count;
+	quint64 thread;
+};
+
+//Lock for the ring buffer, thread names and list of thread buffers
+static QMutex fw_trace_lock;
+static QVector<FWE_TraceSpan> fw_trace_ring;
+static int fw_trace_ring_position = 0;
+static bool fw_trace_ring_wrapped = false;
+static QHash<quint64,QString> fw_trace_thread_names;
+static QSet<FWE_TraceThreadBuffer*> fw_trace_buffers;
+
+//Buffers are destroyed (and flushed) when their thread finishes
+static QThreadStorage<FWE_TraceThreadBuffer*> fw_trace_thread_buffer;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Trace clock is started when the application starts
+////////////////////////////////////////////////////////////////////////////////
+class FWE_TraceClock {
+public:
+	FWE_TraceClock() { timer.start(); }
+	QElapsedTimer timer;
+};
+static FWE_TraceClock fw_trace_clock;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Register buffer of the current thread
+////////////////////////////////////////////////////////////////////////////////
+FWE_TraceThreadBuffer::FWE_TraceThreadBuffer() {
+	thread = (quint64)QThread::currentThreadId();
+
+	QString name = "Thread";
+	if (QThread::currentThread()) {
+		if (QCoreApplication::instance() && (QThread::currentThread() == QCoreApplication::instance()->thread())) {
+			name = "Main thread";
+		} else {
+			name = QThread::currentThread()->metaObject()->className();
+		}
+	}
+
+	fw_trace_lock.lock();
+		fw_trace_thread_names[thread] = name;
+		fw_trace_buffers.insert(this);
+	fw_trace_lock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Keep spans of the finished thread
+////////////////////////////////////////////////////////////////////////////////
+FWE_TraceThreadBuffer::~FWE_TraceThreadBuffer() {
+	fw_trace_lock.lock();
+		flush();
+		fw_trace_buffers.remove(this);
+	fw_trace_lock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void FWE_TraceThreadBuffer::flush() {
+	if (fw_trace_ring.isEmpty()) fw_trace_ring.resize(FWE_TRACE_RING_SPANS);
+
+	int spans_count = count.fetchAndAddAcquire(0);
+	for (int i = 0; i < spans_count; i++) {
+		fw_trace_ring[fw_trace_ring_position++] = spans[i];
+		if (fw_trace_ring_position == FWE_TRACE_RING_SPANS) {
+			fw_trace_ring_position = 0;
+			fw_trace_ring_wrapped = true;
+		}
+	}
+	count.fetchAndStoreRelease(0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+qint64 Trace::getTime() {
+	return fw_trace_clock.timer.nsecsElapsed() / 1000;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Append span to the buffer of the current thread (does not lock unless it's full)
+////////////////////////////////////////////////////////////////////////////////
+void Trace::addSpan(const char* name, qint64 start, qint64 end) {
+	FWE_TraceThreadBuffer* buffer = fw_trace_thread_buffer.localData();
+	if (!buffer) {
+		buffer = new FWE_TraceThreadBuffer();
+		fw_trace_thread_buffer.setLocalData(buffer);
+	}
+
+	int index = buffer->count;
+	if (index == FWE_TRACE_THREAD_SPANS) {
+		fw_trace_lock.lock();
+			buffer->flush();
+		fw_trace_lock.unlock();
+		index = 0;
+	}
+
+	FWE_TraceSpan* span = &buffer->spans[index];
+	span->name = name;
+	span->thread = buffer->thread;
+	span->start = start;
+	span->duration = end - start;
+	buffer->count.fetchAndStoreRelease(index+1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a single span as a complete event
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_Trace_WriteSpan(QTextStream& json, const FWE_TraceSpan& span, bool* first) {
+	if (!(*first)) json << ",\n";
+	*first = false;
+	json << "\t\t{ \"name\": \"" << span.name << "\", \"cat\": \"fwe\", \"ph\": \"X\", ";
+	json << "\"ts\": " << span.start << ", \"dur\": " << span.duration << ", ";
+	json << "\"pid\": 1, \"tid\": " << span.thread << " }";
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool Trace::isEnabled() {
+#ifdef FWE_TRACING
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write spans from the ring buffer and from buffers of running threads
+////////////////////////////////////////////////////////////////////////////////
+bool Trace::exportChromeTrace(const QString& fileName) {
+#ifdef FWE_TRACING
+	QFile output(fileName);
+	if (!output.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		qWarning("Trace::exportChromeTrace: cannot write %s",fileName.toUtf8().data());
+		return false;
+	}
+	QTextStream json(&output);
+	json << "{\n";
+	json << "\t\"displayTimeUnit\": \"ms\",\n";
+	json << "\t\"traceEvents\": [\n";
+
+	bool first = true;
+	fw_trace_lock.lock();
+		//Thread names
+		QHashIterator<quint64,QString> names(fw_trace_thread_names);
+		while (names.hasNext()) {
+			names.next();
+			if (!first) json << ",\n";
+			first = false;
+			json << "\t\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << names.key() << ", ";
+			json << "\"args\": { \"name\": \"" << names.value() << "\" } }";
+		}
+
+		//Oldest spans first
+		if (fw_trace_ring_wrapped) {
+			for (int i = fw_trace_ring_position; i < fw_trace_ring.count(); i++) {
+				FWE_Trace_WriteSpan(json,fw_trace_ring[i],&first);
+			}
+		}
+		for (int i = 0; i < fw_trace_ring_position; i++) {
+			FWE_Trace_WriteSpan(json,fw_trace_ring[i],&first);
+		}
+
+		//Spans not yet moved into the ring buffer
+		foreach (FWE_TraceThreadBuffer* buffer, fw_trace_buffers) {
+			int spans_count = buffer->count.fetchAndAddAcquire(0);
+			for (int i = 0; i < spans_count; i++) {
+				FWE_Trace_WriteSpan(json,buffer->spans[i],&first);
+			}
+		}
+	fw_trace_lock.unlock();
+
+	json << "\n\t]\n";
+	json << "}\n";
+	return true;
+#else
+	qWarning("Trace::exportChromeTrace: tracing is not compiled in (build with FWE_TRACING defined)");
+	return false;
+#endif
+}
@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU General Public License as published by
+/// the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program.  If not, see http://www.gnu.org/licenses/.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_TRACE_H
+#define FWE_TRACE_H
+
+#include <QString>
+
+////////////////////////////////////////////////////////////////////////////////
+/// Tracing of the editor pipeline. Spans are only recorded in builds with
+/// FWE_TRACING defined, otherwise FWE_TRACE() compiles to nothing:
+///
+///		void Object::update(bool visually) {
+///			FWE_TRACE("Object::update");
+///			...
+///
+/// Span names must be string literals (only the pointer is stored). Every thread
+/// records into its own buffer, full buffers are moved into a shared ring buffer
+/// which keeps the most recent spans.
+////////////////////////////////////////////////////////////////////////////////
+namespace FWE {
+	class Trace {
+	public:
+		//Is tracing compiled in
+		static bool isEnabled();
+		//Write recorded spans as Chrome trace JSON (chrome://tracing), returns false on failure
+		static bool exportChromeTrace(const QString& fileName);
+
+#ifdef FWE_TRACING
+		//Get time since start of tracing in microseconds
+		static qint64 getTime();
+		//Record span of the current thread
+		static void addSpan(const char* name, qint64 start, qint64 end);
+#endif
+	};
+
+#ifdef FWE_TRACING
+	class TraceSpan {
+	public:
+		TraceSpan(const char* in_name) { name = in_name; start = Trace::getTime(); }
+		~TraceSpan() { Trace::addSpan(name,start,Trace::getTime()); }
+
+	private:
+		const char* name;
+		qint64 start;
+	};
+#endif
+}
+
+#ifdef FWE_TRACING
+#define FWE_TRACE_CONCAT2(a,b)	a##b
+#define FWE_TRACE_CONCAT(a,b)	FWE_TRACE_CONCAT2(a,b)
+#define FWE_TRACE(name)			FWE::TraceSpan FWE_TRACE_CONCAT(fw_trace_span_,__LINE__)(name)
+#else
+#define FWE_TRACE(name)
+#endif
+
+#endif
@@ -23,6 +23,16 @@ newoption {
    value       = "PATH"
 }
 
+newoption {
+   trigger     = "count-allocations",
+   description = "Count allocations in foxworks_benchmark by replacing global operator new/delete"
+}
+
+newoption {
+   trigger     = "tracing",
+   description = "Record spans of the editor pipeline for Chrome trace export (foxworks_editor --trace)"
+}
+
 newaction {
    trigger     = "moc",
    description = "Generate MOC files for Qt",
@@ -214,8 +224,13 @@ project "GLC_lib"
 
 
 
-project "foxworks_editor"
-   uuid "C84AD4D2-2D63-1842-871E-30B7C71BEA58"
+--------------------------------------------------------------------------------
+-- Editor executable. The benchmark build is the same editor which measures the
+-- editor pipeline on given files and counts allocations (see fwe_benchmark.cpp)
+--------------------------------------------------------------------------------
+function foxworks_editor_project(name, project_uuid)
+project(name)
+   uuid(project_uuid)
    kind "ConsoleApp"
    language "C++"
 
@@ -228,6 +243,7 @@ project "foxworks_editor"
      "../external/qt-solutions/qtpropertybrowser/src",
      "../external/qt-thumbwheel",
      "../external/GLC_lib/src",
+     "../external/GLC_lib/src/3rdparty/zlib",
      
      "../source",
      "../source/dialogs",
@@ -282,3 +298,19 @@ project "foxworks_editor"
       links { "QtCore4", "QtGui4", "QtUiTools", "QtOpenGL4", "opengl32" }
    configuration { "not windows", "Release*" }
       links { "QtCore", "QtGui", "QtUiTools", "QtOpenGL" }
+   configuration { "windows" }
+      links { "psapi" } -- Peak memory usage for benchmarks
+   configuration {}
+
+   if _OPTIONS["tracing"] then
+      defines { "FWE_TRACING" }
+   end
+end
+
+foxworks_editor_project("foxworks_editor","C84AD4D2-2D63-1842-871E-30B7C71BEA58")
+
+foxworks_editor_project("foxworks_benchmark","6A0E3C7B-94D1-4F2B-8C55-1B7E2F3D9A41")
+   defines { "FWE_BENCHMARK" }
+   if _OPTIONS["count-allocations"] then
+      defines { "FWE_BENCHMARK_ALLOCATIONS" }
+   end